@@ -227,6 +227,32 @@ def draw_hist(dico):
             line += 1
     plt.show()
 
+def read_tallies(path):
+    """
+    Read the object tallies written by NVT with the -m option (see NVT.md)
+    Parameters
+        path : the path of the tally file
+    Return
+        list : a DICTIONNARY for each print with the step and numpy arrays
+               n_good, n_bad, n_rotation, n_translation and dl_max indexed by object number
+    """
+    data = open(path, "rb").read()
+    if data[:6] != b"HDTALY" or np.frombuffer(data, np.int32, 1, 6)[0] != 1:
+        raise ValueError(path + " is not a tally file")
+    blocks = []
+    offset = 10
+    while offset < len(data):
+        step, n = np.frombuffer(data, np.int32, 2, offset)
+        offset += 8
+        block = {"step": int(step)}
+        for name in ("n_good", "n_bad", "n_rotation", "n_translation"):
+            block[name] = np.frombuffer(data, np.int32, n, offset)
+            offset += 4 * n
+        block["dl_max"] = np.frombuffer(data, np.float32, n, offset)
+        offset += 4 * n
+        blocks.append(block)
+    return blocks
+
 if __name__ == "__main__":
 
     #THE FIRST STEP IS TO READ THE CONTENT AND SORT IN DICTIONNARY
@@ -250,3 +276,5 @@ if __name__ == "__main__":
         #get n_good, n_bad of each object  n_step_start
     #dico_n_good_n_bad = get_ngood_bad(dico_of_each_object, 40000, 50000, "", 0)
     #draw_graph(dico_n_good_n_bad, 3600, 1)
+
+#===============================================================================
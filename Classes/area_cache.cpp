@@ -0,0 +1,73 @@
+/**
+ * @file    area_cache.cpp
+ * @brief   Implementation of the area_cache class.
+ */
+
+#include "area_cache.h"
+#include <math.h>
+
+area_cache::area_cache(double pos_step, double angle_step, size_t max_size){
+    pos_quantum   = pos_step;
+    angle_quantum = angle_step;
+    max_values    = max_size;
+    n_values      = 0;
+    n_hits        = 0;
+    n_miss        = 0;
+    container     = (polygon *)NULL;
+    pending       = (std::vector<double> *)NULL;
+}
+
+area_cache::~area_cache(){
+    if( container ) delete container;
+}
+
+/**
+ * Find the areas for an object position.
+ * @param poly the container.
+ * @param x, y the position, moved to the nearest grid point.
+ * @param angle the orientation, moved to the nearest grid angle (can be NULL).
+ * @param values set to the vector of areas for the position.
+ * @return true if the areas are already known, false if they must be
+ *         calculated and stored in *values by the caller.
+ */
+bool
+area_cache::lookup(polygon *poly, double *x, double *y, double *angle, std::vector<double> **values){
+    if( pos_quantum <= 0.0 ){
+        *values = &scratch;
+        n_miss++;
+        return false;
+    }
+    if( pending ){                              // Count values filled in since last time
+        n_values += pending->size();
+        pending   = (std::vector<double> *)NULL;
+    }
+    if(( !container ) || ( !container->is_same( poly )) || ( n_values > max_values )){
+        if( container ) delete container;
+        container = new polygon( poly );
+        table.clear();
+        n_values = 0;
+    }
+
+    long long ix = llround( *x / pos_quantum );
+    long long iy = llround( *y / pos_quantum );
+    long long ia = 0;
+    *x = ix * pos_quantum;
+    *y = iy * pos_quantum;
+    if( angle && ( angle_quantum > 0.0 )){
+        long long n_turn = llround( 2.0 * M_PI / angle_quantum );
+        ia = llround( *angle / angle_quantum ) % n_turn;
+        if( ia < 0 ) ia += n_turn;
+        *angle = ia * angle_quantum;
+    }
+    long long key = ((( ix & 0xfffff ) << 20 | ( iy & 0xfffff )) << 20 ) | ( ia & 0xfffff );
+
+    auto found = table.find( key );
+    if( found != table.end() ){
+        *values = &found->second;
+        n_hits++;
+        return true;
+    }
+    *values = pending = &table[ key ];
+    n_miss++;
+    return false;
+}
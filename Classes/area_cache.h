@@ -0,0 +1,55 @@
+/**
+ * @file    area_cache.h
+ * @brief   Header file for the area_cache class.
+ *
+ * @class   area_cache area_cache.h
+ * @brief   Remember area normalisations calculated for a container.
+ *
+ * The analysis programmes normalise their histograms by the area of the
+ * container found at each distance (pcf) or in each cell (2DOrder) from
+ * an object. These areas depend only on the container and the position
+ * (and orientation) of the object, so they can be reused for objects in
+ * similar places, in the same frame or in later frames.
+ *
+ * Positions are snapped to a grid of size pos_quantum and orientations to
+ * multiples of angle_quantum: lookup() moves the position to the grid
+ * point and returns the vector of areas for that point. The cache is
+ * emptied whenever the container changes or when it holds more than
+ * max_values numbers. A pos_quantum of zero disables the cache and the
+ * areas are then calculated at the exact position every time.
+ */
+
+#ifndef AREA_CACHE_H
+#define AREA_CACHE_H
+
+#include "polygon.h"
+#include <unordered_map>
+#include <vector>
+
+#define AREA_CACHE_MAX	(1<<22)		///< Default maximum number of cached values
+
+class area_cache {
+public:
+    area_cache(double pos_quantum,
+               double angle_quantum = 0.0,
+               size_t max_values = AREA_CACHE_MAX);  ///< Constructor with the grid steps
+    virtual ~area_cache();
+
+    bool    lookup(polygon *container,
+                   double *x, double *y, double *angle,
+                   std::vector<double> **values);    ///< Find areas for a position, true if already calculated
+    size_t  n_hits;                     ///< Number of successful lookups
+    size_t  n_miss;                     ///< Number of lookups needing calculation
+
+private:
+    double  pos_quantum;                ///< Grid step for positions (0 no cache)
+    double  angle_quantum;              ///< Grid step for orientations (0 ignore)
+    size_t  max_values;                 ///< Maximum number of values held
+    size_t  n_values;                   ///< Number of values held
+    polygon *container;                 ///< Copy of the container for the values
+    std::vector<double>	scratch;        ///< Space used when there is no cache
+    std::vector<double>	*pending;       ///< Last entry added, not yet counted
+    std::unordered_map<long long, std::vector<double> >	table;
+};
+
+#endif /* AREA_CACHE_H */
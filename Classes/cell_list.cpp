@@ -0,0 +1,100 @@
+/**
+ * @file    cell_list.cpp
+ * @brief   Implementation of the cell_list class.
+ */
+
+#include "cell_list.h"
+#include <algorithm>
+#include <math.h>
+
+cell_list::cell_list(double x_origin, double y_origin, double width, double height,
+                     double min_size, bool wrap){
+    x0       = x_origin;
+    y0       = y_origin;
+    periodic = wrap;
+    nx = ( min_size > 0.0 ) ? (int) floor( width / min_size ) : 1;
+    ny = ( min_size > 0.0 ) ? (int) floor( height / min_size ) : 1;
+    if(( nx < 1 ) || ( periodic && ( nx < 3 ))) nx = 1;
+    if(( ny < 1 ) || ( periodic && ( ny < 3 ))) ny = 1;
+    cell_width  = width / nx;
+    cell_height = height / ny;
+    cells.resize( nx * ny );
+}
+
+cell_list::~cell_list(){
+}
+
+int
+cell_list::cell_x(double x){
+    int k = (int) floor(( x - x0 ) / cell_width );
+    if( periodic ) return (( k % nx ) + nx ) % nx;
+    return ( k < 0 ) ? 0 : (( k >= nx ) ? nx - 1 : k );
+}
+
+int
+cell_list::cell_y(double y){
+    int l = (int) floor(( y - y0 ) / cell_height );
+    if( periodic ) return (( l % ny ) + ny ) % ny;
+    return ( l < 0 ) ? 0 : (( l >= ny ) ? ny - 1 : l );
+}
+
+int
+cell_list::cell(double x, double y){
+    return cell_x( x ) * ny + cell_y( y );
+}
+
+void
+cell_list::insert(int index, double x, double y){
+    int c = cell( x, y );
+
+    if( index >= (int)where.size() ) where.resize( index + 1, -1 );
+    if( where[index] >= 0 ) remove( index );
+    cells[c].push_back( index );
+    where[index] = c;
+}
+
+void
+cell_list::remove(int index){
+    if(( index >= (int)where.size() ) || ( where[index] < 0 )) return;
+    std::vector<int>&   list = cells[ where[index] ];
+    auto found = std::find( list.begin(), list.end(), index );
+
+    *found = list.back();
+    list.pop_back();
+    where[index] = -1;
+}
+
+void
+cell_list::update(int index, double x, double y){
+    int c = cell( x, y );
+
+    if(( index < (int)where.size() ) && ( where[index] == c )) return;
+    insert( index, x, y );
+}
+
+void
+cell_list::neighbours(double x, double y, std::vector<int>& found){
+    int k0 = cell_x( x );
+    int l0 = cell_y( y );
+    int dk = ( nx > 1 ) ? 1 : 0;
+    int dl = ( ny > 1 ) ? 1 : 0;
+
+    for( int k = k0 - dk; k <= k0 + dk; k++ ){
+        int kk = k;
+        if( periodic ) kk = ( kk + nx ) % nx;
+        else if(( kk < 0 ) || ( kk >= nx )) continue;
+        for( int l = l0 - dl; l <= l0 + dl; l++ ){
+            int ll = l;
+            if( periodic ) ll = ( ll + ny ) % ny;
+            else if(( ll < 0 ) || ( ll >= ny )) continue;
+            std::vector<int>& list = cells[ kk * ny + ll ];
+            found.insert( found.end(), list.begin(), list.end() );
+        }
+    }
+}
+
+void
+cell_list::clear(){
+    for( auto& list : cells ) list.clear();
+    where.clear();
+}
@@ -0,0 +1,56 @@
+/**
+ * @file    cell_list.h
+ * @brief   Header file for the cell_list class.
+ *
+ * @class   cell_list cell_list.h
+ * @brief   A uniform grid of cells holding object indices.
+ *
+ * The area from (x0,y0) to (x0+width,y0+height) is divided into cells that
+ * are at least min_size wide, each holding the indices of the objects whose
+ * centre lies in it. All the objects within min_size of a point are then
+ * found in the 3x3 block of cells around it, returned by neighbours().
+ *
+ * With periodic conditions the cells wrap around, a direction with fewer
+ * than 3 cells is not divided so that no cell is visited twice. Without
+ * periodic conditions points outside the area are put in the nearest
+ * edge cell.
+ *
+ * The cell list does not follow the objects: insert(), remove() and update()
+ * must be called when objects are added, removed or displaced. The cell of
+ * each index is remembered so an update only needs the new position.
+ */
+
+#ifndef CELL_LIST_H
+#define CELL_LIST_H
+
+#include <vector>
+
+class cell_list {
+public:
+    cell_list(double x0, double y0,
+              double width, double height,
+              double min_size, bool periodic);  ///< Constructor for an empty grid.
+    virtual ~cell_list();
+
+    void    insert(int index, double x, double y);      ///< Add an object at x,y.
+    void    remove(int index);                          ///< Remove an object.
+    void    update(int index, double x, double y);      ///< Follow an object that moved to x,y.
+    void    neighbours(double x, double y,
+                       std::vector<int>& found);        ///< Append objects in the cells around x,y.
+    int     cell(double x, double y);                   ///< Index of the cell containing x,y.
+    void    clear();                                    ///< Remove all objects.
+
+    int     nx, ny;                     ///< Number of cells in each direction.
+    double  cell_width, cell_height;    ///< Size of the cells.
+
+private:
+    int     cell_x(double x);
+    int     cell_y(double y);
+
+    double  x0, y0;                     ///< Origin of the grid.
+    bool    periodic;                   ///< Cells wrap around.
+    std::vector< std::vector<int> > cells;
+    std::vector<int>    where;          ///< Cell of each index, -1 if absent.
+};
+
+#endif /* CELL_LIST_H */
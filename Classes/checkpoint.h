@@ -0,0 +1,60 @@
+/**
+ * @file    checkpoint.h
+ * @brief   Helpers for the binary checkpoint files.
+ *
+ * A checkpoint holds everything needed to continue an integration exactly
+ * where it stopped: the configuration with the per-object tallies and
+ * cached energies, the integrator state and the random number generator.
+ * Values are written in the native binary representation, so a checkpoint
+ * is only meant to be read back on the same kind of machine.
+ *
+ * The file is structured as:
+ * * the magic string CKPT_MAGIC and the format version,
+ * * a block written by the programme (for NVT the step counter),
+ * * the integrator block (integrator::write_checkpoint), ending with the
+ *   state of its step_controller,
+ * * the configuration block (config::write_checkpoint),
+ * * the random number generator state as a length and a string.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#define CKPT_MAGIC      "HDCKPT"
+#define CKPT_VERSION    4
+
+template <class T>
+inline void
+ckpt_put(std::ostream& dest, const T& value){
+    dest.write( reinterpret_cast<const char *>(&value), sizeof(T) );
+}
+
+template <class T>
+inline void
+ckpt_get(std::istream& src, T& value){
+    if( !src.read( reinterpret_cast<char *>(&value), sizeof(T) ))
+        throw std::runtime_error("Checkpoint file is truncated\n");
+}
+
+inline void
+ckpt_put_string(std::ostream& dest, const std::string& value){
+    ckpt_put(dest, (long) value.size());
+    dest.write( value.data(), value.size() );
+}
+
+inline void
+ckpt_get_string(std::istream& src, std::string& value){
+    long    len;
+
+    ckpt_get(src, len);
+    if( len < 0 ) throw std::runtime_error("Checkpoint file is corrupted\n");
+    value.resize(len);
+    if( !src.read( &value[0], len ))
+        throw std::runtime_error("Checkpoint file is truncated\n");
+}
+
+#endif /* CHECKPOINT_H */
@@ -0,0 +1,40 @@
+/**
+ * @file    common.cpp
+ * @brief   Implementation of the common random number routines.
+ *
+ * The engine is a Mersenne twister, its state is written as text (the
+ * standard library format) so that it can be embedded in checkpoint files
+ * and restored bit for bit.
+ */
+
+#include "common.h"
+#include <sstream>
+#include <stdexcept>
+
+static std::mt19937     the_engine;             // Default seeded, as rand() was.
+
+std::mt19937&
+rnd_engine(){
+    return the_engine;
+}
+
+double
+rnd_uniform(){
+    return std::generate_canonical<double, 53>(the_engine);
+}
+
+void
+rnd_seed(unsigned long seed){
+    the_engine.seed( (std::mt19937::result_type) seed );
+}
+
+void
+rnd_save(std::ostream& dest){
+    dest << the_engine;
+}
+
+void
+rnd_load(std::istream& src){
+    if( !(src >> the_engine) )
+        throw std::runtime_error("Unable to restore the random number generator state\n");
+}
@@ -11,12 +11,24 @@
 #include <assert.h>
 #include <cstdlib>
 #include <cmath>
+#include <iostream>
+#include <random>
 
 #define simple_min(a,b)        (a<b)?(a):(b)
 #define simple_max(a,b)        (a>b)?(a):(b)
 
 #define M_2PI           (M_PI+M_PI)
-#define rnd_lin(range)  ((range*(double)rand())/(double)RAND_MAX)
+#define rnd_lin(range)  ((range)*rnd_uniform())
+
+/*
+ * All the programmes draw their random numbers from a single engine so that
+ * its state can be saved in a checkpoint and a run restarted exactly.
+ */
+std::mt19937&   rnd_engine();                   ///< The shared random number engine.
+double          rnd_uniform();                  ///< Uniform random number in [0,1).
+void            rnd_seed(unsigned long seed);   ///< Reseed the shared engine.
+void            rnd_save(std::ostream& dest);   ///< Write the engine state.
+void            rnd_load(std::istream& src);    ///< Restore the engine state.
 
 #define EXIT_SUCCESS    0
 #define EXIT_FAILURE    1
@@ -12,10 +12,13 @@
  *	x y: coordinates of vertices one per line.
  */
 
+#include <algorithm>
 #include <float.h>
 #include <math.h>
 #include <iostream>
 #include "config.h"
+#include "checkpoint.h"
+#include "space_curve.h"
 #include <boost/format.hpp>
 #include <string>
 #include <random>
@@ -25,6 +28,16 @@
 
 using boost::format;
 
+#define HULL_ARC_STEP   (M_PI/6.0)      // Largest angle of a segment around a hull corner.
+#define JIGGLE_STEP     0.6             // Push relative to the overlap.
+#define JIGGLE_MARGIN   0.01            // Largest extra separation when pushing objects apart.
+#define JIGGLE_NOISE    1.0             // Largest sideways part of a jiggle relative to the overlap.
+#define CHECK_REPORT    20              // Objects described when check_energy() fails.
+#define CURVE_BITS      16              // Largest number of bits of a cell index in curve_keys().
+
+perf_stats config::stats;
+bool       config::trace_moves = false;
+
 /**
  * Constructor that produces an empty basic configuration. This is not
  * currently much use as there are not all the necessary functions for
@@ -41,6 +54,11 @@ config::config() {
     is_rectangle = true;
     n_vertex     = 0;
     poly         = (polygon *)NULL;
+    grid         = (cell_list *)NULL;
+    simple       = false;
+    kernel_force = (force_field *)NULL;
+    dl_epoch     = 0;
+    dl_initial   = 0.0;
 }
 
 /**
@@ -66,109 +84,80 @@ config::config() {
  *              and a couple of lines of code.
  */
 config::config(std::istream& source ){
-    config_read(source);
+    scanner src( source, "configuration" );     // Only read as far as needed.
+    config_read( src );
 }
 
 config::config(string in_file) {
-    // Open a stream of the file
-    ifstream ff(in_file.c_str());
-    config_read( ff );
-    ff.close();
+    scanner src( in_file.c_str() );             // Read the whole file at once.
+    config_read( src );
 }
 
-/**
- * This is messy as defined in topology.cpp
- */
-bool my_getline(std::istream& ff, string *line);
-
 /*
- * Read a configuration file as a stream. 
- * Want to enhance this to:
- * 1. Deal sensibly with errors in the input file
- *    In case of errors it throws runtime_error() with a useful message!
- * 2. Ignore empty lines, and comments "# to end of line"
- *    These are removed by my_getline(ff, line)
+ * Read a configuration with a scanner.
+ * 1. Errors in the input file throw runtime_error() with the position
+ *    of the problem.
+ * 2. Empty lines, and comments "# to end of line" are ignored by the
+ *    scanner.
  */
 void
-config::config_read(std::istream& ff){
+config::config_read(scanner& src){
     int         n_obj;
     int         o_type;
     double      x_pos, y_pos, angle;
-    object      *my_obj;
-    // Plus a string for each line
-    string      line;
-    
+
     is_periodic  = true;                             // Set up defaults.
     is_rectangle = true;
     n_vertex     = 0;
     poly         = (polygon *)NULL;
+    grid         = (cell_list *)NULL;
+    simple       = false;
+    kernel_force = (force_field *)NULL;
+    dl_epoch     = 0;
+    dl_initial   = 0.0;
 
-    // Check if the file exists
-    if(ff.fail()) {
-        throw runtime_error("Could not open configuration file\n");
-    }
-    
-    // We get each line with my_getline(in_file, line)
-    // This fills string with the content of the next line that is not all
-    // whitespace or comment and returns true if it succeeded and false on failure.
-
-    if(!my_getline(ff, &line)){			// Found end of file before content.
-        throw runtime_error("Found no content in the configuration file\n");
-    }
-    istringstream iss(line);
-    if (!(iss >> x_size >> y_size)) {
-        throw runtime_error("First line of the configuration file should be x_size y_size, exiting ...\n");
-    }
-    iss.clear();
+    if(!src.next_line())			// Found end of file before content.
+        src.error("found no content in the configuration file");
+    x_size = src.get_double("x_size");
+    y_size = src.get_double("y_size");
 
     // Here we handle the case of a non-rectangular configuration signalled
-    // by 2 zeros in the first line (after any comments etc)... 
+    // by 2 zeros in the first line (after any comments etc)...
     if( x_size == 0.0 ){
         is_rectangle = false;
         is_periodic = false;
 
-        if(! my_getline(ff, &line))
-            throw runtime_error("Failed to read number of vertices..\n");
-        iss.str(line);
-        if( !(iss >> n_vertex )){
-            throw runtime_error("Failed to read number of vertices...\n");
-        }
-        iss.clear();
+        if(!src.next_line())
+            src.error("file ended before the number of vertices");
+        n_vertex = src.get_int("number of vertices");
         poly = new polygon( n_vertex );
 
         double x_coord, y_coord;
         for( int i = 0; i < n_vertex; i++){
-            if(!my_getline(ff, &line))
-        	throw runtime_error("Error reading bounding polygon coordinates..\n");
-            iss.str(line);
-            if( !(iss >> x_coord >> y_coord )){
-        	throw runtime_error("Error reading bounding polygon coordinates...\n");
-            }
+            if(!src.next_line())
+        	src.error("file ended in the bounding polygon coordinates");
+            x_coord = src.get_double("vertex x coordinate");
+            y_coord = src.get_double("vertex y coordinate");
             poly->add_vertex( x_coord, y_coord );
-            iss.clear();
         }
     }
- 
+
     // Next line the number of objects in the configuration
-    if( !my_getline(ff, &line))
-        throw range_error("Failed to read number of objects..\n");
-    iss.str(line);
-    if (!(iss >> n_obj))
-        throw range_error("Failed to read number of objects...\n");
-    iss.clear();
-    
+    if(!src.next_line())
+        src.error("file ended before the number of objects");
+    n_obj = src.get_int("number of objects");
+    obj_list.reserve( n_obj );
+
     // Now loop through the objects and remaining lines
     for( int i = 0; i < n_obj; i++){
-        if( !my_getline(ff, &line))
-            throw runtime_error("Problem in the coordinates..\n");
-        iss.str(line);
-        if (!(iss >> o_type >> x_pos >> y_pos >> angle))
-            throw runtime_error("Problem in the coordinates...\n");
-        
-        my_obj = new object(o_type, x_pos, y_pos, angle );
-        obj_list.push_back(*my_obj);
-        delete my_obj;
-        iss.clear();
+        if(!src.next_line())
+            src.error("file ended in the object coordinates");
+        o_type = src.get_int("object type");
+        x_pos  = src.get_double("object x position");
+        y_pos  = src.get_double("object y position");
+        angle  = src.get_double("object orientation");
+        obj_list.emplace_back(o_type, x_pos, y_pos, angle );
+        obj_list.back().obj_id = i;
     }
     unchanged = false;                          // Set up so will calculate energy.
     saved_energy = 0.0;
@@ -190,9 +179,13 @@ config::config(config& orig) {
     else
         the_topology = NULL;
     is_periodic    = orig.is_periodic;
+    dl_epoch       = orig.dl_epoch;
+    dl_initial     = orig.dl_initial;
     obj_list.resize(orig.obj_list.size());
     for(int i = 0; i < (int)obj_list.size(); i++){
         obj_list[i].assign(orig.obj_list[i]);
+        if( !orig.obj_list[i].recalculate )     // Keep the cached energies
+            obj_list[i].set_energy( orig.obj_list[i].get_energy() );
     }
     // Add non-periodic bits
     is_rectangle   = orig.is_rectangle;
@@ -201,6 +194,14 @@ config::config(config& orig) {
         poly       = new polygon( orig.poly );
     else
         poly       = NULL;
+    grid           = NULL;               // Rebuilt on demand with build_grid().
+    simple         = orig.simple;        // The kernels suit the copied topology.
+    simple_type    = orig.simple_type;
+    contact        = orig.contact;
+    bounding       = orig.bounding;
+    atom_count     = orig.atom_count;
+    kernel_force   = orig.kernel_force;
+    energy_range2  = orig.energy_range2;
 }
 
 /**
@@ -217,9 +218,13 @@ config::config(config* orig) {
     else
         the_topology = NULL;
     is_periodic    = orig->is_periodic;
+    dl_epoch       = orig->dl_epoch;
+    dl_initial     = orig->dl_initial;
     obj_list.resize(orig->obj_list.size());
     for(int i = 0; i < (int)obj_list.size(); i++){
         obj_list[i].assign(orig->obj_list[i]);
+        if( !orig->obj_list[i].recalculate )    // Keep the cached energies
+            obj_list[i].set_energy( orig->obj_list[i].get_energy() );
     }
     // Add non-periodic bits
     is_rectangle   = orig->is_rectangle;
@@ -228,6 +233,14 @@ config::config(config* orig) {
         poly       = new polygon( orig->poly );
     else
         poly       = NULL;
+    grid           = NULL;               // Rebuilt on demand with build_grid().
+    simple         = orig->simple;      // The kernels suit the copied topology.
+    simple_type    = orig->simple_type;
+    contact        = orig->contact;
+    bounding       = orig->bounding;
+    atom_count     = orig->atom_count;
+    kernel_force   = orig->kernel_force;
+    energy_range2  = orig->energy_range2;
 }
 
 /**
@@ -237,6 +250,7 @@ config::config(config* orig) {
 config::~config() {
     if(the_topology) delete(the_topology);
     if(poly) delete(poly);
+    if(grid) delete(grid);
 }
 
 /**
@@ -251,30 +265,107 @@ double config::area() {
 }
 
 /**
- * This function allow us to dodge all the calcul for the energy of all interaction 
- * if the distance between two objects it's higher than the length.
- * @return booleen value after calculating if we needed to calculate all the interaction.
- *
+ * Choose the pair kernels for the current topology. Record the bounding
+ * radius and the number of atoms of each molecule. With simple molecules, each a single atom at
+ * its centre, also record the atom type of each molecule and the contact
+ * distance of each pair of atom types.
  */
-bool config::need_calculate_energy(double obj1_pos_x, double obj1_pos_y, double obj2_pos_x, double obj2_pos_y, double length, float r_list){
-    //read the radius from the NVT command to fix a radius for the object
-    float dist_bt_pts = 0.0;
-    float dist = 0.0;
-    
-    // distance between points
-    dist_bt_pts = sqrt((obj2_pos_x - obj1_pos_x) * (obj2_pos_x - obj1_pos_x) + (obj2_pos_y - obj1_pos_y) * (obj2_pos_y - obj1_pos_y));
-    
-    //distance minus radius of each object
-    dist =  dist_bt_pts - r_list*2;
-    
-    if (dist > length){
-        return false;
-    }else{
-        return true;
+void
+config::setup_kernels(){
+    simple = ( the_topology != NULL ) && the_topology->is_simple();
+    kernel_force = (force_field *)NULL;
+    simple_type.clear();
+    contact.clear();
+    bounding.clear();
+    atom_count.clear();
+    if( the_topology )
+        for( size_t i = 0; i < the_topology->n_molecules; i++ ){
+            bounding.push_back( the_topology->bounding_radius( i ));
+            atom_count.push_back( the_topology->molecules(i).n_atoms );
         }
-    
+    if( !simple ) return;
+
+    int n = the_topology->n_atom_types;
+    for( size_t i = 0; i < the_topology->n_molecules; i++ )
+        simple_type.push_back( the_topology->molecules(i).the_atoms(0).type );
+    contact.resize( n * n );
+    for( int t1 = 0; t1 < n; t1++ )
+        for( int t2 = 0; t2 < n; t2++ )
+            contact[ t1 * n + t2 ] = the_topology->atom_sizes(t1) + the_topology->atom_sizes(t2);
 }
 
+/**
+ * Interaction energy of object i1 with all the other objects. The SIMPLE
+ * version compares the squared distance between the centres with the
+ * interaction range, the other skips the objects whose bounding circles
+ * are further apart than the cut off and goes through the atoms of both
+ * molecules for the rest.
+ * @param the_force the force field to use for the energy calculation.
+ * @param i1 index of the object.
+ */
+template<bool SIMPLE> double
+config::object_energy( force_field *the_force, int i1 ){
+    double  value = 0.0;
+    object  *my_obj1 = &obj_list[i1];
+    object  *my_obj2;
+    int     n = SIMPLE ? the_topology->n_atom_types : 0;
+
+    long    n_near = 0;                 // Pairs within the interaction range
+    long    n_atom_pairs = 0;
+
+    for(int i2 = 0; i2<(int)obj_list.size(); i2++ ){
+        if(i1 != i2){            // If periodic then
+            double r, r2;
+            double dx = 0.0;
+            double dy = 0.0;
+
+            my_obj2 = &obj_list[i2];
+            if(is_periodic){     // Move my_obj2 to closest image
+                                 // Check this code...
+                r  = my_obj2->pos_x - my_obj1->pos_x;
+                dx = (r<0)?x_size:-x_size;
+                r2 = r + dx;
+                dx = (abs(r2)<abs(r))?dx:0.0;
+                my_obj2->pos_x += dx;
+
+                r  = my_obj2->pos_y - my_obj1->pos_y;
+                dy = (r<0)?y_size:-y_size;
+                r2 = r + dy;
+                dy = (abs(r2)<abs(r))?dy:0.0;
+                my_obj2->pos_y += dy;
+            }
+
+            double ddx = my_obj2->pos_x - my_obj1->pos_x;
+            double ddy = my_obj2->pos_y - my_obj1->pos_y;
+            double d2  = ddx*ddx + ddy*ddy;
+            if( SIMPLE ){        // One atom at each centre, no trigonometry
+                int    t1 = simple_type[ my_obj1->o_type ];
+                int    t2 = simple_type[ my_obj2->o_type ];
+                if( d2 < energy_range2[ t1 * n + t2 ] ){
+                    value += the_force->interaction( t1, 0, t2, sqrt( d2 ));
+                    n_near++;
+                }
+            } else {             // Atoms can only interact within the cut off
+                double reach = bounding[ my_obj1->o_type ] + bounding[ my_obj2->o_type ]
+                               + the_force->cut_off;
+                if( d2 < reach*reach ){
+                    value += my_obj1->interaction( the_force, the_topology, my_obj2 );
+                    n_near++;
+                    n_atom_pairs += atom_count[ my_obj1->o_type ] * atom_count[ my_obj2->o_type ];
+                }
+            }
+
+            if(is_periodic){    // And move back again.
+                my_obj2->pos_x -= dx;
+                my_obj2->pos_y -= dy;
+            }
+        }
+    }
+    stats.n_pairs      += (long)obj_list.size() - 1;
+    stats.n_cut_off    += (long)obj_list.size() - 1 - n_near;
+    stats.n_atom_pairs += SIMPLE ? n_near : n_atom_pairs;
+    return value;
+}
 
 /**
  * This function calculates the energy of a configuration by comparing using
@@ -284,69 +375,42 @@ bool config::need_calculate_energy(double obj1_pos_x, double obj1_pos_y, double
  * easilly. To increase the energy the object recalculate flag, and the
  * configuration unchanged flag are checked to reduce unnecessary evaluations
  * as long as these flags are correctly and efficiently updated.
- * This function call the function need_calculate_energy to check if we need to
- * do the calcul of each atoms interaction of an moving object.
+ * Pairs of objects too far apart to interact are skipped, see object_energy().
+ * The pairs examined are counted in config::stats.
+ * With simple molecules the squared interaction range of each pair of atom
+ * types is taken from the force field the first time it is used.
  *
  * @param  the_force the force field to use for the energy calculation.
  * @return the total interaction energy between all object pairs.
  * @todo   Handle periodic conditions.
  */
-double config::energy(force_field *&the_force, float r_list) {
-    int     i1, i2;                         // Two counters
+double config::energy(force_field *&the_force) {
+    int     i1;                             // Counter
     double  value = 0.0;                    // An accumulator that starts at 0.0
-    object  *my_obj1, *my_obj2;             // Two object pointers
+    object  *my_obj1;                       // Object pointer
+
+    if( simple && ( kernel_force != the_force )){
+        int n = the_topology->n_atom_types;
+        int n_force = simple_min( n, (int)the_force->radius.size() );
+        energy_range2.assign( n * n, 0.0 );
+        for( int t1 = 0; t1 < n_force; t1++ )
+            for( int t2 = 0; t2 < n_force; t2++ ){
+                double range = the_force->range( t1, t2 );
+                energy_range2[ t1 * n + t2 ] = range * range;
+            }
+        kernel_force = the_force;
+    }
 
     if (! unchanged) {                      // Only if necessary
         saved_energy = 0.0;                 // Loop over the objects
-                                            // This code needs optimizing.
         for(i1 = 0; i1 < (int)obj_list.size(); i1++ ){
             my_obj1 = &obj_list[i1];
             if( my_obj1->recalculate ){
-                value = 0.0;
-                for(i2 = 0; i2<(int)obj_list.size(); i2++ ){
-                    if(i1 != i2){            // If periodic then
-                        double r, r2;
-                        double dx = 0.0;
-                        double dy = 0.0;
-
-                        my_obj2 = &obj_list[i2];
-                        if(is_periodic){     // Move my_obj2 to closest image
-                                             // Check this code...
-                            r  = my_obj2->pos_x - my_obj1->pos_x;
-                            dx = (r<0)?x_size:-x_size;
-                            r2 = r + dx;
-                            dx = (abs(r2)<abs(r))?dx:0.0;
-                            my_obj2->pos_x += dx;
-
-                            r  = my_obj2->pos_y - my_obj1->pos_y;
-                            dy = (r<0)?y_size:-y_size;
-                            r2 = r + dy;
-                            dy = (abs(r2)<abs(r))?dy:0.0;
-                            my_obj2->pos_y += dy;
-                        }
-                        
-                        //if radius is define and is superior to 0 in NVT
-                        if (r_list > 0){
-                      
-                            //check if we need to calcul each interaction between the 2 object.
-                            bool decision_maker = need_calculate_energy(my_obj1->pos_x, my_obj1->pos_y, my_obj2->pos_x, my_obj2->pos_y, the_force->length, r_list);
-                            if (decision_maker){
-                            
-                            	 //calculate energy for all interaction
-                                value += my_obj1->interaction( the_force, the_topology, my_obj2 );
-                            }
-                         //radius not define
-                        }else{
-                            value += my_obj1->interaction( the_force,the_topology, my_obj2);
-                        }
-                        
-
-                        if(is_periodic){    // And move back again.
-                            my_obj2->pos_x -= dx;
-                            my_obj2->pos_y -= dy;
-                        }
-                    }
-                }                           // Calculate interaction with wall
+                if( simple )
+                    value = object_energy<true>( the_force, i1 );
+                else
+                    value = object_energy<false>( the_force, i1 );
+                                            // Calculate interaction with wall
                 if(! is_periodic ){         // if not periodic conditions.
                     if( is_rectangle )
                         value += my_obj1->box_energy( the_force, the_topology,
@@ -366,6 +430,97 @@ double config::energy(force_field *&the_force, float r_list) {
     return saved_energy/2.0;                // All interactions are counted twice.
 }
 
+/**
+ * Calculate the energy of each object from scratch, going through every
+ * pair of objects and all their atoms with object::interaction(). Unlike
+ * energy() this uses neither the cached energies, nor the single atom
+ * kernels, nor the bounding radii to skip distant pairs. It is slow and
+ * meant as a reference, see check_energy().
+ *
+ * @param the_force  the force field to use.
+ * @param per_object filled with the energy of each object, including the
+ *                   interaction with the walls.
+ * @return the total energy.
+ */
+double config::reference_energy(force_field *the_force, std::vector<double>& per_object){
+    double  total = 0.0;
+
+    per_object.assign( obj_list.size(), 0.0 );
+    for(int i1 = 0; i1 < (int)obj_list.size(); i1++ ){
+        object  *my_obj1 = &obj_list[i1];
+        for(int i2 = 0; i2 < (int)obj_list.size(); i2++ ){
+            if( i1 == i2 ) continue;
+            object  image( obj_list[i2] );      // Closest image, as in object_energy()
+            if( is_periodic ){
+                double  r  = image.pos_x - my_obj1->pos_x;
+                double  dx = (r<0)?x_size:-x_size;
+                if( abs(r + dx) < abs(r) ) image.pos_x += dx;
+                r  = image.pos_y - my_obj1->pos_y;
+                double  dy = (r<0)?y_size:-y_size;
+                if( abs(r + dy) < abs(r) ) image.pos_y += dy;
+            }
+            per_object[i1] += my_obj1->interaction( the_force, the_topology, &image );
+        }
+        if(! is_periodic ){
+            if( is_rectangle )
+                per_object[i1] += my_obj1->box_energy( the_force, the_topology, x_size, y_size );
+            else
+                per_object[i1] += my_obj1->box_energy( the_force, the_topology, poly );
+        }
+        total += per_object[i1];
+    }
+    return total/2.0;
+}
+
+/**
+ * Check the energies maintained by energy(), with its cached values and
+ * fast paths, against reference_energy(). An object fails the check if
+ * its two energies differ by more than the tolerance, relative to the
+ * energy when this is larger than 1. The failures, worst first, are
+ * described in the report.
+ *
+ * @param the_force the force field to use.
+ * @param tolerance the largest acceptable relative difference.
+ * @param report    a stream for the description of the failures.
+ * @return the number of objects that fail the check (at least 1 if only
+ *         the totals differ).
+ */
+int config::check_energy(force_field *the_force, double tolerance, std::ostream& report){
+    std::vector<double> reference;
+    std::vector<int>    failed;
+    double  fast  = energy( the_force );
+    double  exact = reference_energy( the_force, reference );
+
+    auto differ = [tolerance]( double a, double b ){
+        double  scale = simple_max( fabs(a), fabs(b) );
+        scale = simple_max( scale, 1.0 );
+        return fabs( a - b ) > tolerance * scale;
+    };
+    for(int i = 0; i < (int)obj_list.size(); i++ )
+        if( differ( obj_list[i].get_energy(), reference[i] ))
+            failed.push_back( i );
+    if( failed.empty() && !differ( fast, exact )) return 0;
+
+    std::sort( failed.begin(), failed.end(), [&]( int a, int b ){
+        return fabs( obj_list[a].get_energy() - reference[a] )
+             > fabs( obj_list[b].get_energy() - reference[b] );
+    });
+    report << format("Energy check failed: energy() gives %.10g, the reference %.10g (difference %.4g)\n")
+            % fast % exact % ( fast - exact );
+    report << format("%d of %d objects differ by more than %g\n")
+            % failed.size() % obj_list.size() % tolerance;
+    for(int k = 0; k < (int)failed.size() && k < CHECK_REPORT; k++ ){
+        object  *my_obj = &obj_list[ failed[k] ];
+        report << format("object %d type %d at %g %g angle %g: cached %.10g reference %.10g delta %.4g\n")
+                % failed[k] % my_obj->o_type % my_obj->pos_x % my_obj->pos_y % my_obj->orientation
+                % my_obj->get_energy() % reference[ failed[k] ]
+                % ( my_obj->get_energy() - reference[ failed[k] ] );
+    }
+    if( (int)failed.size() > CHECK_REPORT )
+        report << "...\n";
+    return failed.empty() ? 1 : (int)failed.size();
+}
+
 /**
  * Write the current configuration to a file in a format that can be used to
  * reinitialize a configuration with the file based constructor. See the class
@@ -387,8 +542,10 @@ int config::write( FILE *dest ){
         poly->write( dest );
     }
     fprintf( dest, "%d\n", (int)obj_list.size());
+    std::vector<int>    order;
+    id_order( order );                      // As read, whatever sort_objects() did
     for(int i = 0; i< (int)obj_list.size(); i++){    // For each object in configuration
-        obj_list[i].write(dest);              // Write it to the file -- Pass the stream
+        obj_list[order[i]].write(dest);       // Write it to the file -- Pass the stream
     }
     return EXIT_SUCCESS;                    // Return all well
 }
@@ -416,12 +573,151 @@ int config::write(std::ostream& dest){
     }
     dest << format("%d\n") % obj_list.size();
 
+    std::vector<int>    order;
+    id_order( order );                      // As read, whatever sort_objects() did
     for(int i = 0; i< (int) obj_list.size(); i++){    // For each object in configuration
-        obj_list[i].write(dest);              // Write it to the file -- Pass the stream
+        obj_list[order[i]].write(dest);       // Write it to the file -- Pass the stream
     }
     return EXIT_SUCCESS;                    // Return all well
 }
 
+/**
+ * Write the complete state of the configuration to a binary stream. Unlike
+ * write() this keeps the per-object tallies, step sizes and cached energies
+ * so that an integration restarted with read_checkpoint() continues exactly.
+ * The topology is not included, it is read again from its own file.
+ *
+ * @param dest  A stream opened for binary writing.
+ * @return      EXIT_SUCCESS or EXIT_FAILURE if the stream is in error.
+ */
+int config::write_checkpoint(std::ostream& dest){
+    ckpt_put(dest, x_size);
+    ckpt_put(dest, y_size);
+    ckpt_put(dest, is_periodic);
+    ckpt_put(dest, is_rectangle);
+    ckpt_put(dest, unchanged);
+    ckpt_put(dest, saved_energy);
+    if( is_rectangle ){
+        ckpt_put(dest, (int)0);
+    } else {
+        ckpt_put(dest, poly->n_vertex);
+        for(int i = 0; i < poly->n_vertex; i++ ){
+            ckpt_put(dest, poly->get_vertex(i).x);
+            ckpt_put(dest, poly->get_vertex(i).y);
+        }
+    }
+    ckpt_put(dest, (int)obj_list.size());
+    for(int i = 0; i < (int)obj_list.size(); i++){
+        object *my_obj = &obj_list[i];
+        double energy  = (my_obj->recalculate)?0.0:my_obj->get_energy();
+
+        ckpt_put(dest, my_obj->o_type);
+        ckpt_put(dest, my_obj->pos_x);
+        ckpt_put(dest, my_obj->pos_y);
+        ckpt_put(dest, my_obj->orientation);
+        ckpt_put(dest, my_obj->obj_id);
+        ckpt_put(dest, my_obj->obj_n_good);
+        ckpt_put(dest, my_obj->obj_n_bad);
+        ckpt_put(dest, my_obj->obj_n_rotation);
+        ckpt_put(dest, my_obj->obj_n_translation);
+        ckpt_put(dest, obj_step(i));
+        ckpt_put(dest, my_obj->recalculate);
+        ckpt_put(dest, energy);
+    }
+    return dest.good()?EXIT_SUCCESS:EXIT_FAILURE;
+}
+
+/**
+ * Write the per-object move tallies and step sizes to a binary stream as a
+ * block of columns: the number of objects (int) then, for all the objects
+ * in turn, obj_n_good, obj_n_bad, obj_n_rotation, obj_n_translation (each
+ * an int) and obj_dl_max (a float). As for the checkpoints the values are
+ * in the native binary representation. The objects are in the order of
+ * write(), so a column follows the same object whatever sort_objects() did.
+ *
+ * @param dest  A stream opened for binary writing.
+ * @return      EXIT_SUCCESS or EXIT_FAILURE if the stream is in error.
+ */
+int config::write_tallies(std::ostream& dest){
+    int                 n = (int)obj_list.size();
+    std::vector<int>    column(n);
+    std::vector<float>  dl_max(n);
+    std::vector<int>    order;
+
+    id_order( order );
+    ckpt_put(dest, n);
+    for(int c = 0; c < 4; c++ ){
+        for(int i = 0; i < n; i++ ){
+            object *my_obj = &obj_list[order[i]];
+            column[i] = ( c == 0 ) ? my_obj->obj_n_good :
+                        ( c == 1 ) ? my_obj->obj_n_bad :
+                        ( c == 2 ) ? my_obj->obj_n_rotation : my_obj->obj_n_translation;
+        }
+        dest.write( reinterpret_cast<const char *>(column.data()), n * sizeof(int) );
+    }
+    for(int i = 0; i < n; i++ ) dl_max[i] = obj_step(order[i]);
+    dest.write( reinterpret_cast<const char *>(dl_max.data()), n * sizeof(float) );
+    return dest.good()?EXIT_SUCCESS:EXIT_FAILURE;
+}
+
+/**
+ * Restore a configuration written by write_checkpoint(). Any objects and
+ * boundary already present are replaced, an attached topology is kept.
+ *
+ * @param src   A stream opened for binary reading.
+ * Errors (truncated or corrupted files) throw a runtime_error.
+ */
+void config::read_checkpoint(std::istream& src){
+    drop_grid();
+    int     n_vert, n_obj;
+
+    ckpt_get(src, x_size);
+    ckpt_get(src, y_size);
+    ckpt_get(src, is_periodic);
+    ckpt_get(src, is_rectangle);
+    ckpt_get(src, unchanged);
+    ckpt_get(src, saved_energy);
+    ckpt_get(src, n_vert);
+    if( poly ) delete poly;
+    poly     = (polygon *)NULL;
+    n_vertex = 0;
+    if( !is_rectangle ){
+        if( n_vert < 3 ) throw runtime_error("Checkpoint has an invalid boundary\n");
+        n_vertex = n_vert;
+        poly = new polygon( n_vertex );
+        for(int i = 0; i < n_vertex; i++ ){
+            double x, y;
+            ckpt_get(src, x);
+            ckpt_get(src, y);
+            poly->add_vertex( x, y );
+        }
+    }
+    ckpt_get(src, n_obj);
+    if( n_obj < 0 ) throw runtime_error("Checkpoint has an invalid number of objects\n");
+    obj_list.resize(n_obj);
+    for(int i = 0; i < n_obj; i++){
+        object *my_obj = &obj_list[i];
+        bool   recalculate;
+        double energy;
+
+        ckpt_get(src, my_obj->o_type);
+        ckpt_get(src, my_obj->pos_x);
+        ckpt_get(src, my_obj->pos_y);
+        ckpt_get(src, my_obj->orientation);
+        ckpt_get(src, my_obj->obj_id);
+        ckpt_get(src, my_obj->obj_n_good);
+        ckpt_get(src, my_obj->obj_n_bad);
+        ckpt_get(src, my_obj->obj_n_rotation);
+        ckpt_get(src, my_obj->obj_n_translation);
+        ckpt_get(src, my_obj->obj_dl_max);
+        my_obj->obj_epoch = dl_epoch;
+        ckpt_get(src, recalculate);
+        ckpt_get(src, energy);
+        my_obj->recalculate = true;
+        if( !recalculate ) my_obj->set_energy( energy );
+    }
+}
+
 /**
  * @return The number of objects found in the configuration.
  */
@@ -464,18 +760,42 @@ int config::objects_ntranslation(int obj_number){
  */
 void config::set_obj_dl_max(int obj_number, int dl_max){
     obj_list[obj_number].obj_dl_max = dl_max;                 // update the dl_max of the object.
+    obj_list[obj_number].obj_epoch  = dl_epoch;
+}
+
+/**
+ * Set the dl_max of every object, without going through the objects. A
+ * new epoch is started and the dl_max of an object is replaced by dl_max
+ * the next time it is used, see obj_step().
+ * @param dl_max the new step size of all the objects.
+ */
+void config::reset_obj_dl_max(float dl_max){
+    dl_epoch++;
+    dl_initial = dl_max;
+}
+
+/**
+ * The dl_max of an object, first applying any reset_obj_dl_max() made since
+ * it was last set. All uses of obj_dl_max within the configuration go
+ * through here.
+ * @param obj_number the index of the object.
+ * @return a reference to the obj_dl_max of the object.
+ */
+float& config::obj_step(int obj_number){
+    object  *my_obj = &obj_list[obj_number];
+    if( my_obj->obj_epoch != dl_epoch ){
+        my_obj->obj_dl_max = dl_initial;
+        my_obj->obj_epoch  = dl_epoch;
+    }
+    return my_obj->obj_dl_max;
 }
 
 
 /**
- * This function tests if there is a clash between the 2 objects obj1 and obj2
- *
- * @param obj1 a pointer to the first object.
- * @param obj2 a pointer to the second object.
- * @return true if there is a clash otherwise false.
+ * Clash test going through the atoms of both molecules.
  */
-bool
-config::test_clash( object *obj1, object *obj2 ){
+template<bool SIMPLE> bool
+config::clash_kernel( object *obj1, object *obj2 ){
 
     double  theta1 = obj1->orientation;
     double  theta2 = obj2->orientation;
@@ -485,10 +805,6 @@ config::test_clash( object *obj1, object *obj2 ){
     double  t1, t2, dx1, dx2, dy1, dy2, r1, r2, x1, x2, y1, y2;
     double  dx, dy, r;
 
-    if( ! the_topology ){		// No topology (so no size) just points.
-        return(( obj1->pos_x == obj2->pos_x ) && ( obj1->pos_y == obj2->pos_y ));
-    }
-
     for(int j = 0; j < the_topology->molecules(o_type2).n_atoms; j++ ){
                                         // Get atom information
         t2  =  the_topology->molecules(o_type2).the_atoms(j).type;
@@ -525,6 +841,42 @@ config::test_clash( object *obj1, object *obj2 ){
     return false;
 }
 
+/**
+ * Clash test for single atom molecules centred on the object positions.
+ */
+template<> bool
+config::clash_kernel<true>( object *obj1, object *obj2 ){
+    int     t1 = simple_type[ obj1->o_type ];
+    int     t2 = simple_type[ obj2->o_type ];
+    double  c  = contact[ t1 * the_topology->n_atom_types + t2 ];
+    double  dx = obj2->pos_x - obj1->pos_x;
+    double  dy = obj2->pos_y - obj1->pos_y;
+
+    if( is_periodic ){                  // Find closest image
+        if( dx > ( x_size - c )) dx -= x_size;
+        if( dx < ( c - x_size )) dx += x_size;
+        if( dy > ( y_size - c )) dy -= y_size;
+        if( dy < ( c - y_size )) dy += y_size;
+    }
+    return(( dx*dx + dy*dy ) < c*c );
+}
+
+/**
+ * This function tests if there is a clash between the 2 objects obj1 and obj2
+ *
+ * @param obj1 a pointer to the first object.
+ * @param obj2 a pointer to the second object.
+ * @return true if there is a clash otherwise false.
+ */
+bool
+config::test_clash( object *obj1, object *obj2 ){
+    if( ! the_topology ){		// No topology (so no size) just points.
+        return(( obj1->pos_x == obj2->pos_x ) && ( obj1->pos_y == obj2->pos_y ));
+    }
+    if( simple ) return clash_kernel<true>( obj1, obj2 );
+    return clash_kernel<false>( obj1, obj2 );
+}
+
 /**
  * This function tests if there are any clashes the configuration using the
  * topology file but not the forcefield
@@ -536,6 +888,18 @@ config::test_clash(){
     object *obj1;
     object *obj2;
 
+    if( the_topology ){                     // Use a cell list of the objects.
+        if( !grid ) build_grid();
+        for(int i=0;i<(int)obj_list.size();i++){
+            obj1 = &obj_list[i];
+            grid_found.clear();
+            grid->neighbours( obj1->pos_x, obj1->pos_y, grid_found );
+            for( int j : grid_found ){
+                if(( j < i ) && test_clash( obj1, &obj_list[j] )) return true;
+            }
+        }
+        return false;
+    }
     for(int i=0;i<(int)obj_list.size();i++){
         obj1 = &obj_list[i];
         for(int j=0; j<i; j++){
@@ -578,6 +942,14 @@ config::test_clash( object *new_object ){
                 if( ! poly->is_inside( x1, y1, r1 )) return true;
             }
         }
+    }
+    if( grid ){                             // Only the objects close by.
+        grid_found.clear();
+        grid->neighbours( new_object->pos_x, new_object->pos_y, grid_found );
+        for( int i : grid_found ){
+            if(test_clash( &obj_list[i], new_object )) return true;
+        }
+        return false;
     }
                                             // Loop over the objects.
     for(int i = 0; i < n_objects(); i++){
@@ -652,6 +1024,7 @@ double config::rms(const config& ref){
  * @return      Return if there are clashes.
  */
 bool config::expand(double dl){
+    drop_grid();
     int     i;
 
     if( is_rectangle ){
@@ -680,6 +1053,7 @@ bool config::expand(double dl){
  * @todo        Jiggle and jolt (move and twist to remove clashes) steepest descent
  */
 bool config::expand(double dl, int max_try ){
+    drop_grid();
     int     i;
 
     if( is_rectangle ){
@@ -693,57 +1067,53 @@ bool config::expand(double dl, int max_try ){
         obj_list[i].recalculate = true;// Also for the objects
         obj_list[i].expand(dl);        // Move objects in rescaled box
     }
-    for(i=0;i<max_try;i++){
-      if(test_clash()) jiggle();
+    std::vector<int>    clashing;       // Only move clashing objects.
+    clash_set( clashing );
+    for(i=0;(i<max_try) && !clashing.empty();i++){
+        jiggle( clashing );
     }
-    return test_clash();
+    return !clashing.empty();
 }
 
 /**
- * Generate an angle values for a rotation according to the object symetry. This function is usefull for the 
- * uniform_distribution of "rnd_rotate()" to generate symetrically centered distributions.
- * TODO : a swich value "-q" is a boolean to decide wether or not the rotation motion should be apply
- * It will be better to give a predifined value corespondig to the object symetries: eg 0 for a circular object
- * 3 for a trimer, 4 for a tetramer and so on.
+ * The rotational symmetry of an object type, taken from the topology (see
+ * topology::symmetry()): 0 for a circular object that rotations do not
+ * change, 3 for a trimer, 4 for a tetramer and so on. Rotations by
+ * multiples of 360/symmetry degrees give the same configuration, so only
+ * smaller angles are worth trying.
+ * @param o_type the object type.
+ * @return the order of symmetry, 1 if there is no topology.
  */
  
 int   
-config::side_object(int number_of_side){
-    // This function prefigure a fouction to derrive symetries from an external information eg. topology 
-    // The number of side indeed correspond to this symetry value (4 for tetramers)
-    // It is used to restrict angle arround gaussian distributions whose stdev depend of the obj_mobility factor.
-    // The more the rotation success rate decrease the more the rotation destribition restrict arround 360%number_of side
-
-    return number_of_side;
+config::side_object(int o_type){
+    if( !the_topology ) return 1;
+    return the_topology->symmetry( o_type );
 }
 
 /**
  * generate an angle of rotation for an object according to it's symetry.
+ * The angle is drawn from a normal distribution whose width is the
+ * symmetry angle scaled by the mobility, then folded into the symmetry
+ * angle centred on zero since larger rotations give equivalent orientations.
+ * @param symmetry the order of symmetry of the object, side_object(), not 0.
+ * @param obj_mobility the fraction of moves of the object accepted.
  * @return angle to rotate an object (radian).
  */
  
 float   
-config::rnd_rotate(float obj_mobility){
-    // Create a random device and use it to generate a random seed.
-    std::random_device myRandomDevice;
-    unsigned seed = myRandomDevice();
-    int symet = 4; // for a tetramer. TO DO : implement that in the -q switch in place of the boolean
-    int angmod = 360 / symet ;
-    
-    // Initialize a default_random_engine with the seed.
-    std::default_random_engine generator(seed);
+config::rnd_rotate(int symmetry, float obj_mobility){
+    // Use the shared engine so that runs can be restarted exactly.
+    std::mt19937& generator = rnd_engine();
+    float angmod = 360.0 / symmetry;	// Rotations by angmod change nothing
     
-    /* append an random angle to rotate  */
-    /* Initialize a uniform_int_distribution to produce values between 0 and the side object number */
-    std::uniform_int_distribution<int> uniform_distri(0, side_object(symet));
-    float angle = uniform_distri(generator);
-    angle *= angmod;
-    std::normal_distribution<double> distribution_nor(angle, angmod*obj_mobility);
-    angle = distribution_nor(generator);
+    std::normal_distribution<double> distribution_nor(0.0, angmod*obj_mobility);
+    float angle = distribution_nor(generator);
+    angle -= angmod * round(angle / angmod);
     angle *= M_PI/180;
     /* don't let the angle to rotate down under 1° */
-    if (angle < 0.01745){
-        angle = 0.01745;
+    if (fabs(angle) < 0.01745){
+        angle = copysign(0.01745, angle);
     }
     return angle;
 }
@@ -766,12 +1136,8 @@ config::trans_over_rot(int obj_number, int decision_making_factor){
     int     result; 
     decision_maker = 0;
     
-    // Create a random device and use it to generate a random seed
-    std::random_device myRandomDevice;
-    unsigned seed = myRandomDevice();
-    
-    // Initialize a default_random_engine with the seed.
-    std::default_random_engine generator(seed);
+    // Use the shared engine so that runs can be restarted exactly.
+    std::mt19937& generator = rnd_engine();
     
     /* Use uniform_distribution to determine the next movement : translation, rotate, both */
     /* We use a uniform distribution between obj_n_good & obj_n_bad to generate a decision maker */
@@ -791,7 +1157,8 @@ config::trans_over_rot(int obj_number, int decision_making_factor){
    
 /**
  * Move a given object to a new place using the scaling factor dl_max
- * to control the distance distribution.
+ * to control the distance distribution. With rot_flag the object is also
+ * rotated, within its symmetry angle, unless it is circular.
  *
  * @param obj_number the index of the object to move
  * @param dl_max the scaling parameter.
@@ -799,8 +1166,8 @@ config::trans_over_rot(int obj_number, int decision_making_factor){
 void config::primary_move(int obj_number, double dl_max, bool rot_flag){
     double  dist, angle;
     double  dx, dy;
-    FILE *fptr;   
-    fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */
+    FILE *fptr = NULL;
+    if(trace_moves) fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */
 
     /* Calculate shift distance */
     dist = rnd_lin(1.0);
@@ -816,20 +1183,46 @@ void config::primary_move(int obj_number, double dl_max, bool rot_flag){
     obj_list[obj_number].move(dx, dy);
     obj_list[obj_number].obj_n_translation += 1; 
     
-    if (rot_flag) {
-        /* rotation */
-        angle = rnd_lin(2*M_2PI)-M_2PI;
+    int symmetry = side_object(obj_list[obj_number].o_type);
+    if (rot_flag && (symmetry > 0)) {
+        /* rotation, within the symmetry angle since larger ones change nothing */
+        angle = rnd_lin(M_2PI/symmetry)-M_PI/symmetry;
         obj_list[obj_number].rotate(angle);
         obj_list[obj_number].obj_n_rotation += 1;
     }
-    fprintf(fptr,"\nobject number :  %d ,obj_n_bad : %d, obj_n_good : %d, obj_dl_max ;= %f, dx: %f, dy: %f, angle: %f", obj_number ,obj_list[obj_number].obj_n_bad, obj_list[obj_number].obj_n_good, obj_list[obj_number].obj_dl_max, dx, dy, angle);
-    
-    fclose(fptr);
+    if(trace_moves) {
+        fprintf(fptr,"\nobject number :  %d ,obj_n_bad : %d, obj_n_good : %d, obj_dl_max ;= %f, dx: %f, dy: %f, angle: %f", obj_number ,obj_list[obj_number].obj_n_bad, obj_list[obj_number].obj_n_good, obj_step(obj_number), dx, dy, angle);
+        fclose(fptr);
+    }
     // Fix boundary conditions periodic or not.
     fix_inbox( obj_number );
     
 }
     
+/**
+ * Move an object by a given amount and rotate it by a given angle, as
+ * chosen by a step_controller, counting the translation and rotation in
+ * the object tallies. A zero shift or angle is not counted.
+ *
+ * @param obj_number the index of the object to move.
+ * @param dx         the shift along x.
+ * @param dy         the shift along y.
+ * @param angle      the rotation in radians.
+ */
+void config::displace(int obj_number, double dx, double dy, double angle){
+    object  *my_obj = &obj_list[obj_number];
+
+    if(( dx != 0.0 ) || ( dy != 0.0 )){
+        my_obj->move(dx, dy);
+        my_obj->obj_n_translation += 1;
+    }
+    if( angle != 0.0 ){
+        my_obj->rotate(angle);
+        my_obj->obj_n_rotation += 1;
+    }
+    fix_inbox( obj_number );
+}
+
 /**
  * Move a given object to a new place using the scaling factor dl_max
  * to control the distance distribution. The movement are favorised
@@ -848,14 +1241,14 @@ void config::move_aftern_primary_move(int obj_number, bool rot_flag){
     float  obj_mobility, obj_all_movement;
     float  decision_making_factor = 0.5;
     int     decision_maker;
-    FILE *fptr;   
-    fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */ 
+    FILE *fptr = NULL;
+    if(trace_moves) fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */
     
     /* Calculate shift distance */
     dist = rnd_lin(1.0);
     if (dist == 0.0) dist=DBL_MIN;
     dist = -2.0*log(dist);
-    dist *= obj_list[obj_number].obj_dl_max;
+    dist *= obj_step(obj_number);
 
 	
     
@@ -863,13 +1256,14 @@ void config::move_aftern_primary_move(int obj_number, bool rot_flag){
     /* if decision_maker = 0, we do the both. 1, we only do translation. -1, we just propose rotation to the object. */
     /*A decision_making_factor about 0.5 equally ballance the possibility of rotation over translation */
     
-    if (rot_flag) {
+    int symmetry = side_object(obj_list[obj_number].o_type);
+    if (rot_flag && (symmetry > 0)) {	// Circular objects are never rotated
         decision_maker = trans_over_rot(obj_number, decision_making_factor);
     }
     else {
         decision_maker = 1;
     }    
-    fprintf(fptr,"\nobject number :  %d ,obj_n_bad : %d, obj_n_good : %d, obj_dl_max ;= %f, ", obj_number ,obj_list[obj_number].obj_n_bad, obj_list[obj_number].obj_n_good, obj_list[obj_number].obj_dl_max);
+    if(trace_moves) fprintf(fptr,"\nobject number :  %d ,obj_n_bad : %d, obj_n_good : %d, obj_dl_max ;= %f, ", obj_number ,obj_list[obj_number].obj_n_bad, obj_list[obj_number].obj_n_good, obj_step(obj_number));
     
 
     /* If the decision maker is superior or egal to 0, try to propose a translation to the object */
@@ -884,7 +1278,7 @@ void config::move_aftern_primary_move(int obj_number, bool rot_flag){
     	obj_list[obj_number].move(dx, dy);
     	obj_list[obj_number].obj_n_translation += 1;
     }
-    fprintf(fptr,"dx: %f, dy: %f,", dx, dy);
+    if(trace_moves) fprintf(fptr,"dx: %f, dy: %f,", dx, dy);
     angle = 0;
     /* If the decision maker is inferior or egal to 0, try to rotate */
     if (decision_maker <= 0){
@@ -894,14 +1288,16 @@ void config::move_aftern_primary_move(int obj_number, bool rot_flag){
 	obj_mobility = obj_list[obj_number].obj_n_good/obj_all_movement;
     
    	/* Use normal_distribution to generate the angle to rotation with quarter turns */
-   	angle = rnd_rotate(obj_mobility);
+   	angle = rnd_rotate(symmetry, obj_mobility);
     	
     	/* append the rotation angle to the object. */
     	obj_list[obj_number].rotate(angle);
     	obj_list[obj_number].obj_n_rotation += 1;
     }
-    fprintf(fptr," angle: %f", angle);
-    fclose(fptr);
+    if(trace_moves) {
+        fprintf(fptr," angle: %f", angle);
+        fclose(fptr);
+    }
     // Fix boundary conditions periodic or not.
     fix_inbox( obj_number );
 }
@@ -913,27 +1309,30 @@ void config::move_aftern_primary_move(int obj_number, bool rot_flag){
  *
  * @param obj_number the index of the object
  * @param bad_or_good the index to increase the obj_n_good or obj_n_bad of the selected object.
+ * @param adapt false to only count the move, leaving obj_dl_max unchanged.
  */
 void
-config::modif_mobility( int obj_number, bool bad_or_good, int initial_dl_max){
+config::modif_mobility( int obj_number, bool bad_or_good, int initial_dl_max, bool adapt){
+    float&  dl_max = obj_step(obj_number);
+
     if (bad_or_good){
     	obj_list[obj_number].obj_n_good += 1;	
-    	obj_list[obj_number].obj_dl_max *= 1.1;
+    	if (adapt) dl_max *= 1.1;
     	
     	//don't let the obj_dl_max go higher than 
     	//obj_dl_max haven't to go upper than the initial_dl_max
-    	if (obj_list[obj_number].obj_dl_max > initial_dl_max){
-    	   obj_list[obj_number].obj_dl_max = initial_dl_max;	
+    	if (adapt && dl_max > initial_dl_max){
+    	   dl_max = initial_dl_max;	
         }
     }
     else {
     	obj_list[obj_number].obj_n_bad += 1;
-    	obj_list[obj_number].obj_dl_max /= 1.1;
+    	if (adapt) dl_max /= 1.1;
     	
     	// don't let the obj_dl_max go under 0.1, because we don't want a to propose a translation with : dx, dy = 0
     	//TODO obj_dl_max have to don't go under size obj *0.2 
-    	if (obj_list[obj_number].obj_dl_max < 0.1){
-    	   obj_list[obj_number].obj_dl_max = 0.1;
+    	if (adapt && dl_max < 0.1){
+    	   dl_max = 0.1;
     	}
     }
 
@@ -948,6 +1347,7 @@ config::modif_mobility( int obj_number, bool bad_or_good, int initial_dl_max){
  */
 void
 config::translate( double dx, double dy ){
+    drop_grid();
     if( is_rectangle )
         rect_2_poly();
     poly->translate(dx,dy);
@@ -964,6 +1364,7 @@ config::translate( double dx, double dy ){
  */
 bool
 config::rect_2_poly(){
+    drop_grid();
     if( is_rectangle ){
         // Convert rectangle to poly.
         poly = new polygon( 4 );
@@ -984,6 +1385,7 @@ config::rect_2_poly(){
  */
 bool
 config::poly_2_rect(){
+    drop_grid();
     if( is_rectangle ) return false;
 
     if( !poly->is_parallelogram() ) return false;
@@ -1000,15 +1402,6 @@ config::poly_2_rect(){
     return true;
 }
 
-/**
- * Determine if is p is left of line s->e as the sign of the z component 
- * of the 3D cross product of s->p and s->e.
- */
-bool
-on_left( double px, double py, double sx, double sy, double ex, double ey ){ // Is p on the left of the line s->e
-	return ((ex*py-ex*sy-sx*py-ey*px+ey*sx+sy*px)>0.0);
-}
-
 /**
  * Check if all atoms of all objects are inside the boundary
  * TODO improve this to work with periodic conditions and rectangles properly
@@ -1049,83 +1442,94 @@ config::objects_inside( polygon *a_poly ){
 	return true;
 }
 
+/**
+ * Twice the signed area of the triangle o, a, b: positive if o->a->b
+ * turns to the left.
+ */
+static double
+cross( const Point& o, const Point& a, const Point& b ){
+    return ( a.x - o.x ) * ( b.y - o.y ) - ( a.y - o.y ) * ( b.x - o.x );
+}
+
 /**
  * @brief Calculate convex hull around objects
  * Finds a collection of points, that determine a convex perimeter enclosing
  * all the objects in the configuration.
  *
+ * The hull of the points (the object centres, or with expand the atom
+ * centres) is found with the monotone chain algorithm in O(n log n). To
+ * enclose the atoms it is then pushed out by the largest atom radius R:
+ * each edge moves out by R and around each corner the arc of radius R is
+ * replaced by a few segments tangent to it, so that every atom lies
+ * inside the polygon. The vertices are in clockwise order starting from
+ * the left most point.
+ *
  * @param expand should the hull be expanded to enclose finite sized objects.
  * @return The convex hull calculated as a polygon.
  */
 polygon		*
 config::convex_hull(bool expand){
+    std::vector<Point>  points;
+    double  radius = 0.0;                   // Largest atom radius.
+
+    assert(obj_list.size()>=1);
+    if( expand && the_topology ){           // The atom centres
+        for( int i = 0; i < (int)obj_list.size(); i++ ){
+            object  *my_obj = &obj_list[i];
+            double  c = cos( my_obj->orientation );
+            double  s = sin( my_obj->orientation );
+            for( int j = 0; j < the_topology->molecules(my_obj->o_type).n_atoms; j++ ){
+                atom&   an_atom = the_topology->molecules(my_obj->o_type).the_atoms(j);
+                points.push_back( Point( my_obj->pos_x + an_atom.x_pos * c - an_atom.y_pos * s,
+                                         my_obj->pos_y + an_atom.x_pos * s + an_atom.y_pos * c ));
+                radius = simple_max( radius, the_topology->atom_sizes( an_atom.type ));
+            }
+        }
+    } else {                                // or the object centres.
+        for( int i = 0; i < (int)obj_list.size(); i++ )
+            points.push_back( Point( obj_list[i].pos_x, obj_list[i].pos_y ));
+    }
+    std::sort( points.begin(), points.end(), []( const Point& a, const Point& b ){
+        return ( a.x < b.x ) || (( a.x == b.x ) && ( a.y < b.y )); });
+
+    int n = points.size();                  // Monotone chain, clockwise:
+    int k = 0;
+    std::vector<Point>  hull( 2 * n );
+    for( int i = 0; i < n; i++ ){           // upper hull left to right
+        while(( k >= 2 ) && ( cross( hull[k-2], hull[k-1], points[i] ) >= 0.0 )) k--;
+        hull[k++] = points[i];
+    }
+    for( int i = n - 2, lower = k + 1; i >= 0; i-- ){   // then lower hull back.
+        while(( k >= lower ) && ( cross( hull[k-2], hull[k-1], points[i] ) >= 0.0 )) k--;
+        hull[k++] = points[i];
+    }
+    hull.resize( simple_max( 1, k - 1 ));   // Last point is the first one.
+
     polygon *a_poly = new polygon();
-    assert(obj_list.size()>=3);
-    
-    int	left_most = 0;
-    double x_min = obj_list[0].pos_x;
-    for( int i = 0; i < (int)obj_list.size(); i++ ){
-    	if( obj_list[i].pos_x < x_min ){
-    		x_min = obj_list[i].pos_x;
-    		left_most = i;
-    	}
+    if( !expand || ( radius <= 0.0 )){
+        for( auto& p : hull ) a_poly->add_vertex( p.x, p.y );
+        return a_poly;
     }
 
-    int pointOnHull = left_most;
-    int endpoint = 0;
-    int	i = 0;
-
-    do{
-    	a_poly->add_vertex(obj_list[pointOnHull].pos_x,  obj_list[pointOnHull].pos_y);
-    	endpoint = (pointOnHull == 0)?1:0;
-    	for( int j = 0; j < (int)obj_list.size(); j++ ){
-    		if( j != pointOnHull){
-    		    if( on_left( obj_list[j].pos_x, obj_list[j].pos_y,
-    			    	a_poly->get_vertex(i).x, a_poly->get_vertex(i).y,
-    				    obj_list[endpoint].pos_x, obj_list[endpoint].pos_y) )
-    		        endpoint = j;
-    		}
-    	}
-    	i++;
-    	pointOnHull = endpoint;
-    } while (endpoint != left_most);
-
-	if(expand){									// If necessary increase size to include objects Don't think this works
-	    
-	    double	dl = 0.15 * the_topology->atom_sizes(0);	// A reasonable length to grow by.
-	    double	px, py;										// vector to previous vertex x,y
-	    double  qx, qy;										// vector to next vertex x,y
-	    double  r;											// for normalization
-	    polygon	*new_poly = new polygon();
-	    int		count = a_poly->n_vertex;
-	    do{    	
-	    	for(int i=0; i< count; i++ ){
-	    		px = a_poly->get_vertex((i-1) < 0?a_poly->n_vertex-1:i-1).x -  a_poly->get_vertex(i).x;
-	    		py = a_poly->get_vertex((i-1) < 0?a_poly->n_vertex-1:i-1).y -  a_poly->get_vertex(i).y;
-	    		r  = sqrt( px*px+py*py );
-	    		px /= r;									// Adjust to unit length
-	    		py /= r;
-	    		qx = a_poly->get_vertex((i+1) >= a_poly->n_vertex?0:i+1).x  -  a_poly->get_vertex(i).x;
-	    		qy = a_poly->get_vertex((i+1) >= a_poly->n_vertex?0:i+1).y  -  a_poly->get_vertex(i).y;
-	    		r  = sqrt( qx*qx+qy*qy );
-	    		qx /= r;									// Adjust to unit length
-	    		qy /= r;
-	    		px += qx;
-	    		py += qy;
-	    		r  = - sqrt( px*px+py*py );
-	    		px *= dl/r;									// Adjust to dl length
-	    		py *= dl/r;
-	    		new_poly->add_vertex(a_poly->get_vertex(i).x + px, a_poly->get_vertex(i).y + py);
-	    	}
-    		delete a_poly;
-	   		a_poly = new polygon(new_poly);
-	   		delete new_poly;
-	   		new_poly = new polygon();
-	    } while (!objects_inside( a_poly ));
-		delete new_poly;
-	}	
-
-	return a_poly;
+    int     m = hull.size();
+    for( int i = 0; i < m; i++ ){           // Push out by radius
+        const Point&    prev = hull[( i + m - 1 ) % m];
+        const Point&    curr = hull[i];
+        const Point&    next = hull[( i + 1 ) % m];
+        double  theta_in  = ( m > 1 ) ? atan2( curr.x - prev.x, prev.y - curr.y ) : 0.0;
+        double  theta_out = ( m > 1 ) ? atan2( next.x - curr.x, curr.y - next.y ) : 0.0;
+        double  turn = theta_in - theta_out;    // Clockwise turn of the outward normal.
+        while( turn <= 0.0 ) turn += M_2PI;
+        if( turn > M_2PI ) turn -= M_2PI;
+        int     n_seg = (int) ceil( turn / HULL_ARC_STEP );
+        double  step = turn / n_seg;
+        double  reach = radius * ( 1.0 + 1.0e-9 ) / cos( step / 2.0 );  // Clear of rounding.
+        for( int j = 0; j < n_seg; j++ ){   // Corners of the tangent segments.
+            double  theta = theta_in - ( j + 0.5 ) * step;
+            a_poly->add_vertex( curr.x + reach * cos( theta ), curr.y + reach * sin( theta ));
+        }
+    }
+    return a_poly;
 }
 
 /**
@@ -1134,6 +1538,7 @@ config::convex_hull(bool expand){
  */
 void
 config::set_poly(polygon *a_poly){
+    drop_grid();
 	if(is_rectangle){
 		is_rectangle = false;
 	} else {
@@ -1151,7 +1556,6 @@ config::set_poly(polygon *a_poly){
  * @param obj_number the index of the object to work on.
  */
 void config::fix_inbox( int obj_number ){
-
     double pos_x = obj_list[obj_number].pos_x;
     double pos_y = obj_list[obj_number].pos_y;
 
@@ -1176,6 +1580,7 @@ void config::fix_inbox( int obj_number ){
 
     obj_list[obj_number].pos_x = pos_x;
     obj_list[obj_number].pos_y = pos_y;
+    if( grid ) grid->update( obj_number, pos_x, pos_y );
 }
 
 /**
@@ -1197,6 +1602,7 @@ void config::rotate(int obj_number, double theta_max){
  */
 void
 config::rotate( double angle ){
+    drop_grid();
     if( is_rectangle ) rect_2_poly();
     poly->rotate( angle );
     for(int i=0; i< n_objects(); i++){
@@ -1209,8 +1615,11 @@ config::rotate( double angle ){
 
 
 /**
- * Mark as needing recalculation of energies all objects within a certain
- * distance of a reference object.
+ * Mark as needing recalculation the energy of a reference object and of all
+ * the objects that can interact with it, those whose bounding circle comes
+ * within a certain distance of its bounding circle. Called with the force
+ * field cut off both before and after an object is moved, this flags every
+ * energy that the move can change.
  *
  * @param distance the cut-off distance to use.
  * @param index the number of the reference object.
@@ -1220,10 +1629,14 @@ void    config::invalidate_within(double distance, int index){
     object  *obj2;
 
     obj1 = &obj_list[index];
+    obj1->recalculate = true;
     for(int i=0; i< n_objects(); i++)       // For each object in the configuration
       if (i!= index){                       // That is difference
         obj2 = &obj_list[i];             // Check distance
-        if( obj1->distance(obj2, x_size, y_size, is_periodic) < distance ) // TODO: Need to check works for non-rectangles
+        double reach = distance;
+        if(( obj1->o_type < (int)bounding.size() ) && ( obj2->o_type < (int)bounding.size() ))
+            reach += bounding[ obj1->o_type ] + bounding[ obj2->o_type ];
+        if( obj1->distance(obj2, x_size, y_size, is_periodic) < reach ) // TODO: Need to check works for non-rectangles
             obj2->recalculate = true;       // and set flag if necessary
     }
 }
@@ -1238,6 +1651,8 @@ void    config::add_topology(topology* a_topology){
     if( the_topology )                      // If there is already one
         delete( the_topology );             // Get rid of it
     the_topology = a_topology;              // Make the new association
+    drop_grid();                            // Sizes may have changed
+    setup_kernels();
 }
 
 /**
@@ -1264,12 +1679,122 @@ config::height(){
 
 /** \brief Insert an object into the configuration.
  *
+ * The energy of the configuration must then be recalculated.
  * \param orig the object to add
  * \return nothing
  *
  */
 void    config::add_object(object* orig ){
     obj_list.push_back(*orig);
+    obj_list.back().obj_id = obj_list.size() - 1;
+    unchanged = false;
+    if( grid ) grid->insert( obj_list.size() - 1, orig->pos_x, orig->pos_y );
+}
+
+/**
+ * Build a cell list of the objects so that test_clash(new_object) only
+ * looks at the objects that could touch the new one. The cells are at
+ * least twice the largest bounding radius of the molecules in the
+ * topology, which must be present. The cell list is kept up to date by
+ * add_object(), any other change to the configuration drops it.
+ */
+void    config::build_grid(){
+    double  x0 = 0.0, y0 = 0.0;
+
+    drop_grid();
+    if( !the_topology ) return;
+    stats.n_rebuilds++;
+    if( !is_rectangle ){
+        x0 = poly->x_min();
+        y0 = poly->y_min();
+    }
+    grid = new cell_list( x0, y0, width(), height(),
+                          2.0 * the_topology->max_bounding_radius(), is_periodic );
+    for( int i = 0; i < n_objects(); i++ )
+        grid->insert( i, obj_list[i].pos_x, obj_list[i].pos_y );
+}
+
+/**
+ * The position of each object along a space filling curve through square
+ * cells covering the configuration. Objects with close keys are close in
+ * space. Objects outside the area are given the key of the nearest edge cell.
+ *
+ * @param cell_size the side of the cells, the number of cells in each
+ *                  direction is limited to 2^CURVE_BITS.
+ * @param keys      replaced by the key of each object.
+ * @param hilbert   true for the Hilbert curve, false for the Morton (Z) order.
+ */
+void    config::curve_keys(double cell_size, std::vector<unsigned long>& keys, bool hilbert){
+    double  x0 = 0.0, y0 = 0.0;
+    double  size = std::max( width(), height() );
+
+    if( !is_rectangle ){
+        x0 = poly->x_min();
+        y0 = poly->y_min();
+    }
+    cell_size = std::max( cell_size, size / ( 1 << CURVE_BITS ));
+    int     n = std::max( 1, (int)ceil( size / cell_size ));
+    int     bits = curve_bits( n );
+    keys.resize( obj_list.size() );
+    for( size_t i = 0; i < obj_list.size(); i++ ){
+        int     cx = (int)floor(( obj_list[i].pos_x - x0 ) / cell_size );
+        int     cy = (int)floor(( obj_list[i].pos_y - y0 ) / cell_size );
+        cx = std::min( std::max( cx, 0 ), n - 1 );
+        cy = std::min( std::max( cy, 0 ), n - 1 );
+        keys[i] = hilbert ? hilbert_key( bits, cx, cy ) : morton_key( bits, cx, cy );
+    }
+}
+
+/**
+ * The objects in the order they were read or added, that of their obj_id.
+ * @param order replaced by the indices in obj_list of the objects in turn.
+ */
+void    config::id_order(std::vector<int>& order){
+    order.resize( obj_list.size() );
+    for( size_t i = 0; i < order.size(); i++ ) order[i] = i;
+    std::stable_sort( order.begin(), order.end(),
+            [this](int a, int b){ return obj_list[a].obj_id < obj_list[b].obj_id; } );
+}
+
+/**
+ * Reorder obj_list along the Hilbert curve through cells of twice the
+ * largest bounding radius (curve_keys()), so that objects close in space
+ * are close in memory and the pair loops use the cache better. The
+ * objects keep their tallies, cached energies and obj_id, so write()
+ * still gives them in their original order. Indices of objects held
+ * elsewhere must be translated with new_index.
+ *
+ * @param new_index replaced by the new index of the object at each old index.
+ */
+void    config::sort_objects(std::vector<int>& new_index){
+    int                         n = n_objects();
+    std::vector<unsigned long>  keys;
+    std::vector<int>            order( n );
+    std::vector<object>         sorted( n );
+
+    curve_keys( the_topology ? 2.0 * the_topology->max_bounding_radius() : 0.0, keys );
+    for( int i = 0; i < n; i++ ) order[i] = i;
+    std::stable_sort( order.begin(), order.end(),
+            [&keys](int a, int b){ return keys[a] < keys[b]; } );
+    new_index.resize( n );
+    for( int k = 0; k < n; k++ ){
+        object  *my_obj = &obj_list[order[k]];
+        sorted[k].assign( *my_obj );
+        if( !my_obj->recalculate )          // Keep the cached energies
+            sorted[k].set_energy( my_obj->get_energy() );
+        new_index[order[k]] = k;
+    }
+    obj_list.swap( sorted );
+    drop_grid();                            // Indexed by position in obj_list
+    stats.n_sorts++;
+}
+
+/**
+ * Forget the cell list, clash tests go back to looking at all the objects.
+ */
+void    config::drop_grid(){
+    if( grid ) delete grid;
+    grid = (cell_list *)NULL;
 }
 
 /** \brief Fetch object from list by index
@@ -1359,8 +1884,19 @@ config::ps_atoms( std::ostream& dest ){
     }
 }
 
+/**
+ * Check if object i clashes with any other object.
+ */
 bool
 config::has_clash( int i ){
+    if( grid ){
+        grid_found.clear();
+        grid->neighbours( obj_list[i].pos_x, obj_list[i].pos_y, grid_found );
+        for( int j : grid_found ){
+            if(( i != j ) && test_clash( &obj_list[i], &obj_list[j] )) return true;
+        }
+        return false;
+    }
     for(int j=0; j< (int) obj_list.size(); j++ ){
         if (i!=j) {
             if( test_clash( &obj_list[i], &obj_list[j] )) return true;
@@ -1369,29 +1905,123 @@ config::has_clash( int i ){
     return false;
 }
 
+/**
+ * Measure how much two objects overlap. The overlap of each pair of
+ * atoms is added, as a vector along the line from the atom of obj2 to the
+ * atom of obj1, to push_x, push_y: moving obj1 in this direction separates
+ * the objects.
+ *
+ * @return the largest overlap of two atoms, 0.0 if the objects do not clash.
+ */
+double
+config::overlap( object *obj1, object *obj2, double *push_x, double *push_y ){
+    double  depth = 0.0;
+
+    for(int j = 0; j < the_topology->molecules(obj2->o_type).n_atoms; j++ ){
+        atom&   atom2 = the_topology->molecules(obj2->o_type).the_atoms(j);
+        double  r2 = the_topology->atom_sizes(atom2.type);
+        double  x2 = obj2->pos_x + atom2.x_pos * cos(obj2->orientation) - atom2.y_pos * sin(obj2->orientation);
+        double  y2 = obj2->pos_y + atom2.x_pos * sin(obj2->orientation) + atom2.y_pos * cos(obj2->orientation);
+
+        for( int k = 0; k < the_topology->molecules(obj1->o_type).n_atoms; k++ ){
+            atom&   atom1 = the_topology->molecules(obj1->o_type).the_atoms(k);
+            double  r1 = the_topology->atom_sizes(atom1.type);
+            double  dx = obj1->pos_x + atom1.x_pos * cos(obj1->orientation)
+                         - atom1.y_pos * sin(obj1->orientation) - x2;
+            double  dy = obj1->pos_y + atom1.x_pos * sin(obj1->orientation)
+                         + atom1.y_pos * cos(obj1->orientation) - y2;
+            if( is_periodic ){          // Closest image
+                dx -= x_size * round( dx / x_size );
+                dy -= y_size * round( dy / y_size );
+            }
+            double  r = sqrt( dx*dx + dy*dy );
+            if( r >= r1 + r2 ) continue;
+            if( r > 0.0 ){
+                *push_x += ( r1 + r2 - r ) * dx / r;
+                *push_y += ( r1 + r2 - r ) * dy / r;
+            }
+            depth = simple_max( depth, r1 + r2 - r );
+        }
+    }
+    return depth;
+}
+
+/**
+ * Find all the objects that clash with another object.
+ * @param clashing the indices of the clashing objects.
+ */
+void
+config::clash_set( std::vector<int>& clashing ){
+    clashing.clear();
+    if( !grid ) build_grid();
+    for( int i = 0; i < (int)obj_list.size(); i++ ){
+        if( has_clash( i )) clashing.push_back( i );
+    }
+}
+
 /***
  * @brief Shake objects a bit to try and remove bad contacts
+ *
+ * Each object in the clashing set is pushed away from the objects it
+ * overlaps by a little more than half the overlap (its partner will
+ * usually move too), plus a random sideways displacement of the same
+ * order and a small rotation so that blocked arrangements can change.
+ * The sideways part is perpendicular to the push so it never moves the
+ * object back into the overlap, and the extra separation is random so
+ * that an object squeezed between two others does not bounce between
+ * them. Only exactly superposed objects, which have no push direction,
+ * move in a random direction. The clashing set is then replaced by
+ * the objects that still clash, which can only be the moved objects and
+ * their neighbours.
+ *
+ * @param clashing the indices of the clashing objects, updated.
  */
 void
-config::jiggle(){
-    double  dist, angle;
-    double  dx, dy;
+config::jiggle( std::vector<int>& clashing ){
+    std::vector<int>    moved;
+    std::vector<int>    partners;
+    std::vector<bool>   listed( obj_list.size(), false );
+
+    if( !the_topology ) return;         // Points can not be pushed apart.
+    if( !grid ) build_grid();
+    for( int i : clashing ){
+        double  push_x = 0.0, push_y = 0.0, depth = 0.0;
+
+        partners.clear();
+        grid->neighbours( obj_list[i].pos_x, obj_list[i].pos_y, partners );
+        for( int j : partners ){
+            if( i != j )
+                depth = simple_max( depth, overlap( &obj_list[i], &obj_list[j], &push_x, &push_y ));
+        }
+        if( depth == 0.0 ) continue;    // Freed by an earlier move.
+
+        double  push = sqrt( push_x * push_x + push_y * push_y );
+        double  dx, dy;
+        if( push > 0.0 ){
+            double  along = JIGGLE_STEP * depth + rnd_lin( JIGGLE_MARGIN );
+            double  aside = rnd_lin( 2.0 * JIGGLE_NOISE * depth ) - JIGGLE_NOISE * depth;
+            dx = ( along * push_x - aside * push_y ) / push;
+            dy = ( along * push_y + aside * push_x ) / push;
+        } else {                        // Exactly superposed.
+            double  angle = rnd_lin(M_2PI);
+            dx = ( depth + JIGGLE_MARGIN ) * cos( angle );
+            dy = ( depth + JIGGLE_MARGIN ) * sin( angle );
+        }
+        double  twist = depth / simple_max( the_topology->bounding_radius( obj_list[i].o_type ), depth );
 
-    for( int i=0; i < (int)obj_list.size(); i++){
-        if( has_clash( i )){
-            /* Calculate shift distance */
-            dist = rnd_lin(1.0);
-            if (dist == 0.0) dist=DBL_MIN;
-            dist = -2.0*log(dist);
-            /* Use angle to calculate coordinate shift */
-            angle = rnd_lin(1.0);
-            dy = dist * cos(M_2PI*angle);
-            dx = dist * sin(M_2PI*angle);
-
-            obj_list[i].move(dx,dy);
-            fix_inbox( i );
-            angle = rnd_lin(M_2PI)-M_PI;
-            obj_list[i].rotate(angle);
+        obj_list[i].move( dx, dy );
+        obj_list[i].rotate( rnd_lin( 2.0 * twist ) - twist );
+        fix_inbox( i );
+        moved.push_back( i );
+    }
+    clashing.clear();                   // Who still clashes?
+    for( int i : moved ){
+        partners.clear();
+        grid->neighbours( obj_list[i].pos_x, obj_list[i].pos_y, partners );
+        for( int j : partners ){
+            if(( i == j ) || !test_clash( &obj_list[i], &obj_list[j] )) continue;
+            if( !listed[i] ){ listed[i] = true; clashing.push_back( i ); }
+            if( !listed[j] ){ listed[j] = true; clashing.push_back( j ); }
         }
     }
 }
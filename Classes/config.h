@@ -35,6 +35,11 @@
  * * ps_atoms(ff, fp) that produces a postscript snippet containing a representation
  *              of the different atoms.
  * * ps_box(fp) that produces a postscript path of the boundaries.
+ * * write_checkpoint(dest) that writes the complete state, including the
+ *              per-object tallies and cached energies, in a binary form that
+ *              read_checkpoint(src) restores exactly.
+ * * write_tallies(dest) that writes the per-object move tallies and step
+ *              sizes as binary columns.
  *
  * Methods that return information on the configuration.
  * * area() returns the surface are enclosed by the bounding box.
@@ -42,15 +47,45 @@
  * * object_types() returns the number of different types of object (not very useful)
  * * energy(ff) returns the energy of the configuration using the forcefield
  *              ff for the calculation.
+ * * check_energy(ff, tol, report) compares the energies maintained by energy()
+ *              with those calculated from scratch by reference_energy().
+ *
+ * When every molecule of the topology is a single atom at its centre (as
+ * for the default hard discs) the pair energy and clash tests use kernels
+ * specialised for that case, which compare the squared distance between
+ * the centres with a precomputed value for each pair of atom types.
+ *
+ * The work done by energy() and build_grid() is tallied in the static
+ * member stats (see perf_stats), shared with the integrators. Setting the
+ * static member trace_moves appends every move, and its outcome in
+ * integrator::run(), to NEW_algorithme_movement.txt for debugging.
+ *
+ * * curve_keys(size, keys) gives the position of the cell of each object
+ *              along a Hilbert (or Morton) curve through cells of the given
+ *              size, see space_curve.h.
+ * * sort_objects(new_index) reorders the objects in memory along a Hilbert
+ *              curve, keeping each object's obj_id. Output (write(),
+ *              write_tallies()) is always in the order the objects were
+ *              read or added, given by id_order().
+ * * build_grid() indexes the objects in a cell list so that the clash tests
+ *              only look at nearby objects. add_object() and the moves of single
+ *              objects keep it up to date, other modifications discard it (drop_grid()).
  *
  * Methods that modify the configuration.
  * * expand(dl) change the area of the configuration by an isometric expansion
  *              using the multiplicative factor dl for all coordinates.
- *              (Identity operation if dl = 1).
+ *              (Identity operation if dl = 1). expand(dl, max_try) then pushes
+ *              the clashing objects apart, at most max_try times.
  * * move( no, dl ) move object number 'no' by a random amount controlled by
  *              the scaling factor dl. (Identity operation if dl = 0)
  * * rotate( no, dth ) rotate object number 'no' by a random angle controlled
  *              by the scaling factor dth. (Identity operation if dth = 0).
+ * * displace( no, dx, dy, angle ) move object number 'no' by dx, dy and
+ *              rotate it by angle, the moves proposed by a step_controller.
+ * * reset_obj_dl_max( dl ) sets the step size of every object to dl. The
+ *              objects are not visited, instead an epoch counter is
+ *              incremented and each object takes the new value the next time
+ *              its step size is used (obj_step()).
  * * invalidate_within( r, no ) This marks the energies associated with objects
  *              less than the distance 'r' from object number 'no' as needing
  *              recalculation.
@@ -76,6 +111,9 @@
 
 #include "object.h"
 #include "polygon.h"
+#include "scanner.h"
+#include "cell_list.h"
+#include "perf_stats.h"
 
 using namespace std;
 
@@ -96,18 +134,34 @@ public:
     int         		write(FILE *dest);  ///< Write the conformation to a 'c' file.
     void        		ps_atoms(std::ostream& dest
                                );   ///< Write the postscript part for the atoms.
+    int         		write_checkpoint(std::ostream& dest
+                              );    ///< Write the complete state in binary for a restart.
+    void        		read_checkpoint(std::istream& src
+                              );    ///< Restore a state written by write_checkpoint().
+    int         		write_tallies(std::ostream& dest
+                              );    ///< Write the per-object tallies in binary columns.
 
 /* Setting up a configuration */
     void      			add_topology(topology *a_topology
                                  ); ///< Attach a topology to the configuration
     void        		add_object(object *orig
                                  ); ///< Insert an object in the configuration
+    void        		build_grid();       ///< Index the objects in a cell list to speed up insertion.
+    void        		drop_grid();        ///< Discard the cell list.
+    void        		curve_keys(double cell_size, std::vector<unsigned long>& keys,
+                                 bool hilbert = true); ///< Position of each object along a space curve.
+    void        		sort_objects(std::vector<int>& new_index
+                                 ); ///< Reorder the objects along a space curve.
+    void        		id_order(std::vector<int>& order
+                                 ); ///< The objects in the order they were read.
     double      		x_size;             ///< The width of rectangular configuration
     double  		   y_size;             ///< The height of rectangular configuration
     double				width();            ///< The width of any configuration
     double				height();           ///< The height of any configuration
     bool        		unchanged;          ///< Is the configuration unchanged since the last evaluation of energy.
     bool        		is_periodic;        ///< Use periodic boundary conditions
+    static perf_stats	stats;              ///< Timers and counters shared by all configurations.
+    static bool			trace_moves;        ///< Append every move to NEW_algorithme_movement.txt (debugging).
 
     bool     		   is_rectangle;       ///< Use x_size, y_size rather then a polygon.
     int					n_vertex;	    ///< Number of vertices in polygon (doublon)
@@ -115,11 +169,14 @@ public:
 
 /* Obtaining information on the configuration */
     double  			area();                 ///< Return the total area of the configuation.
-    bool 			need_calculate_energy(double obj1_pos_x, double obj1_pos_y, double obj2_pos_x, double obj2_pos_y, double length, float r_list); ///< check if we need to calculate the 																		interaction between 2 objects. just to save calculation time
     int     			object_types();         ///< The number of different object types.
     int     			n_objects();            ///< The number of objects in configuration.
 
-    double  			energy(force_field *&the_force, float r_list);   ///< Calculate the energy of a conformation using the given force field. r_list is just drop here to be used by need_calculate_energy() to check if we need to calculate interaction between 2 objects.
+    double  			energy(force_field *&the_force);   ///< Calculate the energy of a conformation using the given force field.
+    double  			reference_energy(force_field *the_force,
+                                 std::vector<double>& per_object); ///< Energy of each object from scratch, for checking.
+    int     			check_energy(force_field *the_force, double tolerance,
+                                 std::ostream& report); ///< Compare energy() with reference_energy().
     bool    			test_clash( object *new_object); ///< Check if there is a clash to insert new object.
     bool    			test_clash();           ///< Check if there are any clashes between objects.
     double  			rms(const config& ref); ///< Calculate rms difference from a second conformation.
@@ -128,6 +185,8 @@ public:
     bool    			expand( double dl );    ///< Expand the surface area by a factor dl.
     bool    			expand( double dl, int max_try);    ///< Expand the surface area by a factor dl allow several attempts to remove clashes.
     void    			primary_move(int obj_number, double dl_max, bool rot_flag);  ///< Move an object in the configuration. (First move comportement)
+    void    			displace(int obj_number, double dx, double dy,
+                                 double angle); ///< Move and rotate an object by given amounts.
     void    			move_aftern_primary_move(int obj_number, bool rot_flag); ///<  moderate translation and rotation thank's to the attribute obj_n_good and obj_n_bad of a selected object. (second move comportement)
     void    			translate( double dx, double dy );   ///< Translate the whole reference frame dx, dy 
     void    			rotate( double theta ); ///< Rotate the configuration by theta around 0,0
@@ -140,31 +199,55 @@ public:
     polygon		*convex_hull(bool expand);		///< Calculate convex hull around objects.
     void		set_poly(polygon *a_poly);		///< Set a_poly as new perimeter.
     							 
-    void 			modif_mobility( int obj_number, bool bad_or_good, int initial_dl_max); ///< modify the mobility ratio of the selected object by increasing obj_n_good or obj_n_bad and obj_dl_max.
-    int			        side_object(int number_of_side); ///<  return the max number of rotation according to the object symetries. The function need to be truely implemented, currently a workaround
-    								///(this function is usefull for rnd_rotate()) TODO Need to be optimized, example : for a circle return 360.
+    void 			modif_mobility( int obj_number, bool bad_or_good, int initial_dl_max,
+                                 bool adapt = true); ///< modify the mobility ratio of the selected object by increasing obj_n_good or obj_n_bad and obj_dl_max.
+    int			        side_object(int o_type); ///<  return the order of rotational symmetry of an object type from the topology, 0 for a circle.
     								
-    float 			rnd_rotate(float obj_mobility);  ///< generate an angle of rotation for an object according to it's symetries. this function use side_object() to define the symetry
+    float 			rnd_rotate(int symmetry, float obj_mobility);  ///< generate an angle of rotation for an object according to it's symetry, see side_object()
     int 			trans_over_rot(int obj_number, int choice_ratio); ///< generate a number in [-1;1] thanks to obj_n_good and obj_n_bad of an object to make a choice between rotation, 												translation or both. case : -1 -> rotation , 0 -> both, 1 -> translation
     int			objects_nbad(int obj_number); ///< return the number of n_bad of an specific object
     int			objects_ngood(int obj_number); ///< return the number of n_good of an specific object
     int 			objects_ntranslation(int obj_number); ///< return the number of translation done by an object.
     int 			objects_nrot(int obj_number); ///< return the number of rotation done by an object.
     void 			set_obj_dl_max(int obj_number, int dl_max); ///< set a dl_max for a selected object.
+    void 			reset_obj_dl_max(float dl_max); ///< set the dl_max of every object, in constant time.
     
 private:
     bool        		test_clash( object *o1, object *o2
                                  ); ///< Check if there is a clash between 2 objects.
     bool        		has_clash( int i ); ///< check if the object with index i has a clash. 
-    void        		jiggle();           ///< Shake objects a bit to try and remove bad contacts.
+    double      		overlap( object *o1, object *o2,
+                                 double *push_x, double *push_y
+                                 ); ///< How much, and in which direction, 2 objects overlap.
+    void        		clash_set( std::vector<int>& clashing
+                                 ); ///< Find the objects that clash.
+    void        		jiggle( std::vector<int>& clashing
+                                 ); ///< Push clashing objects apart to try and remove bad contacts.
 
-    void					config_read(std::istream& src); ///< Helper function reading from a stream.
+    void					config_read(scanner& src);     ///< Helper function reading with a scanner.
+    void        		setup_kernels();    ///< Choose the pair kernels suited to the topology.
+    template<bool SIMPLE> bool   clash_kernel( object *o1, object *o2
+                                 ); ///< Clash test for a pair of objects.
+    template<bool SIMPLE> double object_energy( force_field *the_force, int i1
+                                 ); ///< Interaction energy of object i1 with all the others.
 
     double      		saved_energy;       ///< The last result of energy evaluation.
+    cell_list   		*grid;              ///< Cell list of the objects, or NULL.
+    std::vector<int>	grid_found;         ///< Work space for the cell list searches.
     std::vector<object>	obj_list;           ///< The objects in the configuration
     topology    		*the_topology;      ///< The object topology file.
+    bool        		simple;             ///< Every molecule is a single atom at its centre.
+    std::vector<int>	simple_type;        ///< The atom type of each molecule, if simple.
+    std::vector<double>	contact;            ///< Sum of the radii of each pair of atom types, if simple.
+    std::vector<double>	bounding;           ///< Bounding radius of each molecule type.
+    std::vector<int>	atom_count;         ///< Number of atoms of each molecule type.
+    force_field 		*kernel_force;      ///< The force field energy_range was computed for.
+    std::vector<double>	energy_range2;      ///< Squared interaction range of each pair of atom types.
     bool        		check();            ///< Is the current configuration valid?
     bool 				objects_inside(polygon *a_poly);///< Verify all objects are inside perimeter.
+    float&      		obj_step(int obj_number); ///< The dl_max of an object, after any pending reset.
+    int         		dl_epoch;           ///< Incremented by each reset_obj_dl_max().
+    float       		dl_initial;         ///< The dl_max set by the last reset_obj_dl_max().
 };
 
 #endif /* CONFIG_H */
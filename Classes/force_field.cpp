@@ -6,6 +6,7 @@
 
 #include "common.h"
 #include "force_field.h"
+#include "scanner.h"
 #include <cstring>
 #include <ctype.h>
 #include <string>
@@ -27,6 +28,7 @@ force_field::force_field() {
     barrier     = 0.0; // this parameters allow to fix a distance (from the disk edge) to set up an energy barrier
     type_max   = 0;
     big_energy = BIGVALUE;
+    wall_length = 0.0;
 }
 
 force_field::force_field(const force_field& orig) {
@@ -37,6 +39,11 @@ force_field::force_field(const force_field& orig) {
     barrier     = orig.barrier;
     type_max   = orig.type_max;
     big_energy = orig.big_energy;
+    wall_length = orig.wall_length;
+    wall_energy = orig.wall_energy;
+    radius.resize( type_max );
+    color.resize( type_max );
+    energy.resize( type_max, type_max );
     for( i=0; i< type_max; i++ ){
         radius(i) = orig.radius(i);
         color[i]  = orig.color[i];
@@ -45,19 +52,15 @@ force_field::force_field(const force_field& orig) {
 }
 
 force_field::force_field( const char *file_name ){
-    FILE *source;
     cut_off    = 2.0;
     length     = 1.0;
     barrier     = 0.0;  // this parameters allow to fix a distance (from the disk edge) to set up an energy barrier
     type_max   = 0;
     big_energy = BIGVALUE;
+    wall_length = 0.0;
 
-    if(( source = fopen( file_name, "r" )) != NULL ){
-        read_force_field( source );
-        fclose( source );
-    } else {
-        throw std::runtime_error("Error opening file");
-    }
+    scanner source( file_name );
+    read_force_field( source );
 }
 
 force_field::force_field( FILE *source ){
@@ -66,8 +69,10 @@ force_field::force_field( FILE *source ){
     barrier    = 0.0;  // this parameters allow to fix a distance (from the disk edge) to set up an energy barrier
     type_max   = 0;
     big_energy = BIGVALUE;
+    wall_length = 0.0;
 
-    read_force_field( source );
+    scanner src( source, "force field" );
+    read_force_field( src );
 }
 
 force_field::force_field( float r ){
@@ -77,6 +82,7 @@ force_field::force_field( float r ){
     barrier    = 0.0; // this parameters allow to fix a distance (from the disk edge) to set up an energy barrier
     type_max   = 1;
     big_energy = BIGVALUE;
+    wall_length = 0.0;
     
     radius.resize(1);
     color.resize(1);
@@ -87,87 +93,58 @@ force_field::force_field( float r ){
     energy(0,0) = 0.0;
 }
 
-#define	COMMENTCHAR	'#'
-
-bool
-force_field::is_comment( char *line ){
-//  Comments are lines of whitespace or lines
-//  That start (possibly after whitespace) with
-//  COMMENTCHAR...
-    int i=0;
-    while( line[i] != '\0' ){
-        if( isspace( line[i] )) i++;
-        else
-            return( line[i] == COMMENTCHAR );
-    }
-    return( true );
-}
-
+/**
+ * Read a force field.
+ * @param source a scanner positioned at the start of the force field.
+ *
+ * The file holds, ignoring blank lines and comments:
+ * * the number of atom types,
+ * * a line of radii and a line of colours, one per type,
+ * * the cut off, the length scale and optionally the barrier distance,
+ * * the matrix of interaction energies, one row per line,
+ * * optionally a line starting with the word wall, followed by the range
+ *   of the wall potential and the well depth of each atom type.
+ *
+ * Anything after the last expected field of a line is ignored, as are
+ * any other lines following the energy matrix. Errors throw a runtime_error
+ * giving the line and column of the problem.
+ */
 void
-force_field::read_force_field( FILE *source ){
-/*
-**  Need to add more error handling and checking,
-**  Need to add documentation.
-**  Should relax formatting restrictions.
-*/
-    char	*line = NULL;
-    size_t	len = 0;
-    ssize_t     read;
-    int		logical_line = 0;
-    int         line_number = 0;
-    int		i, j = 0;
-    double       number;
+force_field::read_force_field( scanner& source ){
+    int		i, j;
 
-    while(( read = getline( &line, &len, source )) != -1 ){
-    	istringstream iss(line);
-    	char color_name[32];		        // 32 is maximum length of a color
-        line_number++;
-        if( !is_comment( line )){
-            switch( logical_line ){
-            case 0: iss >> type_max;	// Number of different atom types
-                    if( type_max <= 0 ){                // Sanity check
-                        throw std::runtime_error( "Error in force field file Line number "
-                            + std::to_string(line_number)
-                            + " : Invalid number of atom types "
-                            + std::to_string(type_max) );
-                    }
-                    radius.resize( type_max );          // Resize arrays as necessary.
-                    color.resize(type_max);
-                    energy.resize(type_max, type_max);
-                    logical_line++;                     // Move on
-                    break;
-            case 1: for( i = 0; i < type_max; i++ ){     // sizes
-                        iss >> number;
-                        radius[i] = number;
-                    }
-                    logical_line++;
-                    break;
-            case 2: for( i = 0; i < type_max; i++ ){    // colors
-            			iss >> color_name;
-                        color(i) = color_name;
-                        printf("color : %s \n", color(i).c_str());
-                    }
-                    logical_line++;
-                    break;
-            case 3: 	                                // interaction cutoff distance, length scale and energy barrier value.
-                    iss >> cut_off >> length >> barrier;
-                    logical_line++;
-                    break;
-            case 4: for( i = 0; i < type_max; i++ ){    // Read in energy matrix
-                        iss >> number;
-                        energy(i,j) = number;
-                        printf(" number : %f \n", number);
-                    }
-                    if( ++j == type_max )
-                        logical_line++;
-                    break;
-            default:
-                    break;
-           }
-        }
-        iss.clear();
+    if( !source.next_line() )
+        source.error("empty force field, expected the number of atom types");
+    type_max = source.get_int("number of atom types");
+    if( type_max <= 0 )                                 // Sanity check
+        source.error("invalid number of atom types " + std::to_string(type_max));
+    radius.resize( type_max );                          // Resize arrays as necessary.
+    color.resize(type_max);
+    energy.resize(type_max, type_max);
+
+    if( !source.next_line() ) source.error("file ended before the atom radii");
+    for( i = 0; i < type_max; i++ )
+        radius[i] = source.get_double("atom radius");
+    if( !source.next_line() ) source.error("file ended before the atom colors");
+    for( i = 0; i < type_max; i++ )
+        color(i) = source.get_word("atom color");
+    if( !source.next_line() ) source.error("file ended before the cut off");
+    cut_off = source.get_double("cut off");             // interaction cutoff distance, length scale
+    length  = source.get_double("length");              // and optional energy barrier value.
+    source.try_double( &barrier );
+    for( j = 0; j < type_max; j++ ){                    // Read in energy matrix
+        if( !source.next_line() ) source.error("file ended in the energy matrix");
+        for( i = 0; i < type_max; i++ )
+            energy(i,j) = source.get_double("interaction energy");
+    }
+    if( source.next_line() && ( source.get_word("wall") == "wall" )){
+        wall_length = source.get_double("wall length");
+        if( wall_length < 0.0 )
+            source.error("negative wall length " + std::to_string(wall_length));
+        wall_energy.resize( type_max );
+        for( i = 0; i < type_max; i++ )
+            wall_energy[i] = source.get_double("wall energy");
     }
-    free( line );					// Free line that is implicitly allocated.
 }
 
 force_field::~force_field() {                           // Probably need to get rid of arrays.
@@ -341,6 +318,32 @@ force_field::interaction(int t1, int number_atom_obj1, int t2, double r) {
     return value;
 }
 
+/**
+ * Interaction of an atom with the wall of a closed container, a hard
+ * wall with an optional triangular well, like the pair interactions.
+ * @param t1 the atom type.
+ * @param gap distance from the wall to the surface of the atom, negative
+ *        if the atom crosses the wall.
+ */
+double
+force_field::wall_interaction(int t1, double gap) {
+    if( gap < 0.0 ) return big_energy;
+    if( gap < wall_length ) return wall_energy(t1) * (1.0 - gap/wall_length);
+    return 0.0;
+}
+
+/**
+ * The interaction() of two atoms is zero once their centres are further
+ * apart than the cut off, or than the sum of their radii plus the length
+ * scale (just the sum of the radii if their well depth is zero).
+ */
+double
+force_field::range(int t1, int t2) {
+    double hard = radius(t1) + radius(t2);
+    double reach = ( energy(t1, t2) == 0.0 ) ? hard : hard + length;
+    return ( reach < cut_off ) ? reach : cut_off;
+}
+
 double  force_field::size(int t1){
     return radius[t1];
 }
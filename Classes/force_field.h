@@ -26,6 +26,8 @@
  * * A cut_off distance beyond which all interactions are zero.
  * * A big_number that is a stand_in for infinity but avoids the numerical
  *   problems associated with infinity.
+ * * Optionally a soft wall: a range and a well depth for each atom type
+ *   at the wall of a closed container.
  *
  * Constructor methods are defined for a a default force_field and a
  * copy constructor, and a destructor method.
@@ -47,6 +49,7 @@
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/io.hpp>
+#include "scanner.h"
 
 using namespace boost::numeric::ublas;      // For vector and matrix
 
@@ -65,22 +68,25 @@ public:
 
     void        update(std::string ff_filename);
     double      interaction(int t1, int number_atom_obj1, int t2, double r); ///< Calculate interaction energy
+    double      wall_interaction(int t1, double gap); ///< Energy of an atom gap from the wall
+    double      range(int t1, int t2);      ///< Distance beyond which atoms of types t1 and t2 do not interact.
     double      size(int t1);               ///< The hard core size of an atom type t1.
     void        write(FILE *dest);          ///< Write the forcefield to file
     void        write(std::ostream& dest);  ///< Write the forcefield to a stream.
     const char  *get_color(int t);          ///< Color for plot output should get rid of this (color in atoms)
     double      cut_off;                    ///< Distance cutoff between objects (part of integrator not force field)
     double      big_energy;                 ///< Large value less than infinity.
+    double      wall_length;                ///< Range of the soft wall, 0 for a hard wall only.
 
     vector<double>      radius;             ///< Atom radii (should not be here atom properties)
 private:
-    void        read_force_field(FILE *source);	    ///< Constructor from file helper routine
-    bool	is_comment( char *line );   ///< Check if line from a file is a comment...
+    void        read_force_field(scanner& source);    ///< Constructor from file helper routine
 
     int         type_max;                   ///< The number of different atom types
     int         cutoff;                     ///< The cutoff
     vector< std::string>  color;            ///< Atom colors for postscript (should not be here)
     matrix<double>      energy;             ///< Pairwise interaction well depths.
+    vector<double>      wall_energy;        ///< Well depth of each atom type at the wall.
 };
 
 #endif /* FORCE_FIELD_H */
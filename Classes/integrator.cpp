@@ -10,10 +10,14 @@
 
 #include <math.h>
 #include "integrator.h"
+#include "checkpoint.h"
 #include "common.h"
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <algorithm>
 
 /**
  * Constructor function that takes as a parameter the force field that will be
@@ -26,11 +30,16 @@ integrator::integrator(force_field *forces) {
     n_bad      =
     rot_flag   = false; 
     n_step     = 0;
+    sweep      = false;
+    sweep_next = 0;
     n_try	=200; //this parameter was created to change the move behaviour after n_try.
     dl_max     = 1.0; 
     initial_dl_max = 1.0; //this parameters allow us to reassign obj_dl_max of object after n_steps
     i_adjust   = 1000;
+    check_freq = 0;
+    check_tolerance = 1e-9;
     the_forces = forces;
+    controller = new legacy_controller();
 }
 
 /**
@@ -43,30 +52,91 @@ integrator::integrator(const integrator& orig) {
     n_good     = orig.n_good;
     n_bad      = orig.n_bad;
     rot_flag   = orig.rot_flag;
+    sweep      = orig.sweep;
+    sweep_order = orig.sweep_order;
+    sweep_next = orig.sweep_next;
     dl_max     = orig.dl_max;
     initial_dl_max = orig.initial_dl_max;
     n_step     = orig.n_step;
     n_try      = orig.n_try;
     i_adjust   = orig.i_adjust;
+    check_freq = orig.check_freq;
+    check_tolerance = orig.check_tolerance;
     the_forces = orig.the_forces;
+    controller = orig.controller->clone();
 }
 
 /**
  * Destructor to destroy an integrator.
  */
 integrator::~integrator() {
+    delete controller;
+}
+
+/**
+ * Replace the step controller that chooses the moves.
+ *
+ * @param a_controller The new controller, owned by the integrator from now on.
+ */
+void
+integrator::set_controller(step_controller *a_controller) {
+    delete controller;
+    controller = a_controller;
+}
+
+/**
+ * Start a new sweep: the objects are sorted by the Hilbert key of their
+ * cell, with a random order within each cell, and the direction along the
+ * curve is chosen at random.
+ *
+ * @param the_state The configuration whose objects are to be moved.
+ */
+void
+integrator::new_sweep(config *the_state) {
+    std::vector<unsigned long> keys;
+    std::vector< std::tuple<unsigned long, double, int> > sorted;
+
+    the_state->curve_keys(the_forces->cut_off, keys);
+    for(int k = 0; k < (int)keys.size(); k++)
+        sorted.push_back( std::make_tuple( keys[k], rnd_uniform(), k ));
+    std::sort( sorted.begin(), sorted.end() );
+    if( rnd_lin(1.0) < 0.5 ) std::reverse( sorted.begin(), sorted.end() );
+    sweep_order.resize( sorted.size() );
+    for(size_t k = 0; k < sorted.size(); k++) sweep_order[k] = std::get<2>( sorted[k] );
+    sweep_next = 0;
+}
+
+/**
+ * Reorder the objects of a configuration along a space curve so that
+ * neighbours are close in memory, see config::sort_objects(). The
+ * remaining objects of the current sweep are translated to their new
+ * places.
+ *
+ * @param the_state The configuration to reorder.
+ */
+void
+integrator::sort_objects(config *the_state) {
+    std::vector<int> new_index;
+
+    the_state->sort_objects(new_index);
+    if( sweep_order.size() == new_index.size() )
+        for(size_t k = 0; k < sweep_order.size(); k++) sweep_order[k] = new_index[sweep_order[k]];
 }
 
 /**
  * @brief Function to run a series of steps of integration on a configuration.
  *
  * Currently this integration is performed by at each time point:
- * - If necessary adjusting the integrator parameters and resetting the tallies.
- * - Moving an object in the configuration.
+ * - If necessary adjusting the step sizes (controller) and resetting the tallies.
+ * - Choosing an object, at random or the next of a sweep, and moving it as
+ *   chosen by the controller.
  * - Working out which parts of the energy need to be re-evaluated.
  * - Calculating a new energy for the configuration.
  * - Accepting or rejecting the configuration based on the metropolis criterion.
- * - Updating the integrator tallies.
+ * - Updating the integrator and controller tallies.
+ *
+ * The time spent moving, calculating the energy and accepting or rejecting
+ * is charged to config::stats, when its timers are enabled.
  *
  * @param state_h a handle to the configuration. This will be updated during
  *                the run, so the_state at the end is different if a change is
@@ -75,68 +145,56 @@ integrator::~integrator() {
  *                to use for the integration.
  * \param P       The pressure.
  * @param n_steps The number of requested steps to make.
- * @param r_list  The radius of object (fixed by NVT command)
  * @return        The total number of steps so far performed.
+ * Throws a runtime_error if an energy check fails, the state handle then
+ * points to the configuration that failed.
  *
  */
 int
-integrator::run(config **state_h, double beta, double P, int n_steps, float r_list){
+integrator::run(config **state_h, double beta, double P, int n_steps){
     int     i;              ///< Iteration counter
     int     obj_number;     ///< Index of object to modify
     double  dU;             ///< Internal energy change.
     double  prob_new;       ///< Acceptance probability.
     config  *the_state = *state_h;
     config  *new_state;     ///< Pointer to modified state.
-    bool    debug = false;   ///< Debuging option to control acceptance criteria.
+    bool    debug = config::trace_moves;   ///< Debuging option to control acceptance criteria.
+    int     move_kind;      ///< The kind of move made by the controller.
 
     
     for(i = 0; i < n_steps; i++){
+        config::stats.mark();
         /* If necessary adjust integrator parameters and tallies */
-        if((n_step > 0) && ((n_step % i_adjust)== 0)){
-            if(((float)n_good/(n_good+n_bad)) < 0.1) dl_max /= 3.9;
-            if(((float)n_good/(n_good+n_bad)) > 0.7) dl_max *= 3.0;
-            dl_max = simple_min( dl_max, the_state->x_size);
-            dl_max = simple_min( dl_max, the_state->y_size);
-            
-            //don't let the dl_max down too much
-            dl_max = simple_max(dl_max, 0.1);
-            n_good = n_bad = 0;
-    }
-    	//reset the dl_max of each object every n steps.
-    	if((n_step > 0) && ((n_step % 2000)== 0)){
-            //set obj_dl_max to each object
-            for (int obj_number = 0; obj_number < the_state->n_objects(); obj_number++){
-                the_state->set_obj_dl_max(obj_number, initial_dl_max);
-            }
-        }
+        controller->adjust(*this, the_state, n_step);
+        if((n_step > 0) && ((n_step % i_adjust)== 0)) n_good = n_bad = 0;
+
         /** Clone configuration and move an object in the new configuration */
-        /** @todo   Chose between different types of modification           */
         new_state = new config(*the_state);
         
         /// The integrator move function.
-        obj_number = rnd_lin(1.0)*the_state->n_objects();
-        
-        // follow primary_move() if the selected object doesn't try a specific number of move 
-        if((the_state->objects_ngood(obj_number)+the_state->objects_nbad(obj_number))<n_try){
-            new_state->primary_move(obj_number, dl_max, rot_flag);
-            //printf("Old Algo \n");
-        // follow second model of move when the selected object try to move n_try times.
-        } else{
-            new_state->move_aftern_primary_move(obj_number, rot_flag);
-            //printf("New Algo \n");
-         }
+        if( sweep ){
+            if(( sweep_next >= (int)sweep_order.size() ) ||
+               ( (int)sweep_order.size() != the_state->n_objects() )) new_sweep(the_state);
+            obj_number = sweep_order[sweep_next++];
+        } else {
+            obj_number = rnd_lin(1.0)*the_state->n_objects();
+        }
+        new_state->invalidate_within(the_forces->cut_off, obj_number);   // Neighbours before the move
+        move_kind = controller->propose(*this, new_state, obj_number);
          
-        new_state->invalidate_within(the_forces->cut_off, obj_number);
+        new_state->invalidate_within(the_forces->cut_off, obj_number);   // and after it.
         new_state->unchanged = false;
+        config::stats.charge(perf_stats::MOVE);
         
         /* Calculate probability of accepting the new state                */
-        dU = new_state->energy(the_forces, r_list)
-                - the_state->energy(the_forces, r_list);
+        dU = new_state->energy(the_forces)
+                - the_state->energy(the_forces);
         prob_new = exp(- beta * dU );
         prob_new = simple_min(1.0,prob_new);
+        config::stats.charge(perf_stats::ENERGY);
         
-	FILE *fptr;   
-    	fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */ 
+	FILE *fptr = NULL;
+	if(debug) fptr = fopen("NEW_algorithme_movement.txt", "a");/*  open for writing */
 	
         /* Accept or reject the new state according to the probability     */
         if(rnd_lin(1.0)<= prob_new ){
@@ -146,24 +204,90 @@ integrator::run(config **state_h, double beta, double P, int n_steps, float r_li
             n_good++;
             delete(the_state);               
             the_state = new_state;
-            
-            //increase obj_n_good of the selected object & increase the obj_dl_max
-            the_state->modif_mobility(obj_number, true, initial_dl_max);
+            controller->tally(*this, the_state, obj_number, move_kind, true);
         } else {
 	    if(debug) {
                 fprintf(fptr," n_step = %d refused", n_step);
 	    }
             n_bad++;
             delete(new_state); 
-             
-            //increase obj_n_bad of the selected object & reduce the obj_dl_max 
-            the_state->modif_mobility(obj_number, false, initial_dl_max);
+            controller->tally(*this, the_state, obj_number, move_kind, false);
         }
 	if(debug) {  
             fclose(fptr);
         }
         n_step++;
+        config::stats.n_steps++;
+        config::stats.charge(perf_stats::ACCEPT);
+
+        /* If requested check the energy against a full calculation        */
+        if(( check_freq > 0 ) && ( n_step % check_freq == 0 )){
+            std::ostringstream report;
+            if( the_state->check_energy(the_forces, check_tolerance, report) ){
+                *state_h = the_state;
+                throw std::runtime_error( "After " + std::to_string(n_step) + " steps. " + report.str() );
+            }
+            config::stats.charge(perf_stats::ENERGY);
+        }
     }
     *state_h = the_state;
     return n_step;
 }
+
+/**
+ * Write the state of the integrator (tallies, step sizes, the step
+ * counter, the current sweep and the state of the controller) to a binary stream, as part of
+ * a checkpoint.
+ *
+ * @param dest  A stream opened for binary writing.
+ * @return      EXIT_SUCCESS or EXIT_FAILURE if the stream is in error.
+ */
+int
+integrator::write_checkpoint(std::ostream& dest){
+    ckpt_put(dest, n_good);
+    ckpt_put(dest, n_bad);
+    ckpt_put(dest, rot_flag);
+    ckpt_put(dest, i_adjust);
+    ckpt_put(dest, dl_max);
+    ckpt_put(dest, initial_dl_max);
+    ckpt_put(dest, n_try);
+    ckpt_put(dest, n_step);
+    ckpt_put(dest, sweep);
+    ckpt_put(dest, sweep_next);
+    ckpt_put(dest, (int)sweep_order.size());
+    for(size_t k = 0; k < sweep_order.size(); k++) ckpt_put(dest, sweep_order[k]);
+    ckpt_put(dest, controller->type());
+    controller->write_checkpoint(dest);
+    return dest.good()?EXIT_SUCCESS:EXIT_FAILURE;
+}
+
+/**
+ * Restore the integrator state written by write_checkpoint(). The force
+ * field is not part of the checkpoint and is left unchanged, the
+ * controller must be of the same type as the one saved.
+ *
+ * @param src   A stream opened for binary reading.
+ */
+void
+integrator::read_checkpoint(std::istream& src){
+    ckpt_get(src, n_good);
+    ckpt_get(src, n_bad);
+    ckpt_get(src, rot_flag);
+    ckpt_get(src, i_adjust);
+    ckpt_get(src, dl_max);
+    ckpt_get(src, initial_dl_max);
+    ckpt_get(src, n_try);
+    ckpt_get(src, n_step);
+    ckpt_get(src, sweep);
+    ckpt_get(src, sweep_next);
+    int     n_order;
+    ckpt_get(src, n_order);
+    if( n_order < 0 ) throw std::runtime_error("Checkpoint file is corrupted\n");
+    sweep_order.resize( n_order );
+    for(int k = 0; k < n_order; k++) ckpt_get(src, sweep_order[k]);
+    int     type;
+    ckpt_get(src, type);
+    if( type != controller->type() )
+        throw std::runtime_error("Checkpoint written with a different step controller\n");
+    controller->read_checkpoint(src);
+}
@@ -13,8 +13,25 @@
  * a configuration and the integration parameters (temperature and pressure)
  * together with the number of integration steps to take.
  *
- * Currently the nature of the steps is hard coded as are the various integration
- * counters and control parameters.
+ * The moves, and how their size adapts to the acceptance, are chosen by a
+ * step_controller, by default the legacy_controller. The integrator owns
+ * its controller, set_controller() replaces it.
+ *
+ * By default each step moves an object chosen at random. With 'sweep' set
+ * the objects are instead moved in turn, in sweeps that follow a Hilbert
+ * curve through cells the size of the cut off (config::curve_keys()), so
+ * that successive moves touch nearby objects and the same data. The
+ * objects in a cell are taken in a random order, and each sweep goes along
+ * the curve in a random direction.
+ *
+ * sort_objects() reorders the objects of a configuration in memory along a
+ * Hilbert curve (config::sort_objects()), the current sweep carries on
+ * with the same objects.
+ *
+ * If check_freq is set the energies maintained incrementally are compared
+ * every check_freq steps with a calculation from scratch
+ * (config::check_energy()), a difference larger than check_tolerance
+ * stops the run with a runtime_error describing the objects involved.
  *
  * @todo    The integrator should incorporate more of the choices about
  *          integration to allow different types of dynamics. So there should
@@ -26,6 +43,7 @@
 #define INTEGRATOR_H
 
 #include "config.h"
+#include "step_controller.h"
 
 class integrator {
 public:
@@ -33,16 +51,28 @@ public:
     integrator(const integrator& orig);     ///< Constructor with copy
     virtual ~integrator();                  ///< Destructor
     int     run(config **state_handle, double beta,
-                double P, int n_step, float r_list);      ///< Run n_step integration steps
+                double P, int n_step);      ///< Run n_step integration steps
+    int     write_checkpoint(std::ostream& dest);  ///< Write the integrator state in binary.
+    void    read_checkpoint(std::istream& src);    ///< Restore a state written by write_checkpoint().
+    void    set_controller(step_controller *a_controller); ///< Replace the step controller.
+    void    sort_objects(config *the_state);        ///< Reorder the objects in memory, following them in the sweep.
+    step_controller *controller;            ///< Chooses the moves and their size.
     int     n_good;                         ///< Integrator tally, number of accepted moves.
     int     n_bad;                          ///< Integrator tally, number of rejected moves.
     bool    rot_flag;			    ///< True to include rotation in the MC moves
+    bool    sweep;                          ///< Move the objects in turn along a space curve.
     int     i_adjust;                       ///< Frequency of integrator adjustment.
     double  dl_max;                         ///< Maximum move distance.
     double  initial_dl_max;                 ///< initial dl_max to reset obj_dl_max of each object after n_step.
     int  n_try;		             ///< number of tentative before passing from the differents algorithme of the move.
+    int     check_freq;                     ///< Steps between energy checks, 0 for none.
+    double  check_tolerance;                ///< Largest relative energy error accepted by the checks.
 private:
+    void    new_sweep(config *the_state);   ///< Choose the order of the next sweep.
+
     int     n_step;                         ///< Number of integrator steps made so far.
+    std::vector<int> sweep_order;           ///< The objects in the order of the current sweep.
+    int     sweep_next;                     ///< Position of the next object in sweep_order.
     force_field *the_forces;
 };
 
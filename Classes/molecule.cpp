@@ -4,12 +4,14 @@
 molecule::molecule(){
     mol_name = "";
     n_atoms = 0;
+    symmetry = 1;
 }
 
 molecule::molecule(molecule *orig){
     int     i;
     mol_name = orig->mol_name;
     n_atoms = orig->n_atoms;
+    symmetry = orig->symmetry;
     the_atoms.resize( n_atoms );
     for( i=0; i< n_atoms; i++ ){
         the_atoms(i).copy( orig->the_atoms(i));
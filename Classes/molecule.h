@@ -8,6 +8,10 @@
  * \class   molecule molecule.h
  * \brief   A class describing the structure of molecules.
  *
+ * The rotational symmetry of a molecule is the number of rotations about
+ * its origin, by multiples of 360/symmetry degrees, that leave its atoms
+ * unchanged: 1 for an asymmetric molecule, 4 for a square tetramer and 0
+ * for a molecule unchanged by any rotation (all its atoms at the origin).
  */
 
 #ifndef MOLECULE_H
@@ -36,6 +40,7 @@ public:
 
     std::string		mol_name;	///< A name for the molecule
     int         	n_atoms;	///< The number of atoms in the molecule
+    int         	symmetry;	///< Order of rotational symmetry, 0 if circular
     vector<atom>	the_atoms;	///< The individual atoms in a vector
 };
 
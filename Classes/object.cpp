@@ -8,6 +8,7 @@
 #include "object.h"
 #include <math.h>
 #include <float.h>
+#include <algorithm>
 #include "common.h"
 #include <boost/format.hpp>
 #include <fstream>
@@ -31,6 +32,8 @@ object::object() {
     obj_n_rotation = 0;	/// number of rotation done by an object
     obj_n_translation = 0;	/// number of translation done by an object
     obj_dl_max = 0;		/// number of dl_max of an object
+    obj_epoch = 0;		/// obj_dl_max set in the first epoch
+    obj_id = -1;		/// set when added to a configuration
 }
 
 /**
@@ -52,6 +55,8 @@ object::object(int  type, double x_pos, double y_pos, double angle ) {
     obj_n_rotation = 0;	/// number of rotation done by an object
     obj_n_translation = 0;	/// number of translation done by an object
     obj_dl_max = 0;		/// number of dl_max of an object
+    obj_epoch = 0;		/// obj_dl_max set in the first epoch
+    obj_id = -1;		/// set when added to a configuration
 }
 
 /**
@@ -85,6 +90,8 @@ object::assign(const object& orig) {
     obj_n_rotation = orig.obj_n_rotation;
     obj_n_translation = orig.obj_n_translation;
     obj_dl_max = orig.obj_dl_max;
+    obj_epoch = orig.obj_epoch;
+    obj_id = orig.obj_id;
 }
 
 /**
@@ -134,27 +141,15 @@ void    object::rotate(float angle){
  *
  */
 double  object::distance(object* obj2, double x_size, double y_size, bool periodic){
-    double dx, dy, dx2, dy2;
+    double dx, dy;
 
-    dx = pos_x - obj2->pos_x;
-    dx *= dx;
-    dy = pos_y - obj2->pos_y;
-    dy *= dy;
-    if(periodic){
-        dx2 = pos_x + x_size;
-        dx2 *= dx2;
-        dx  = simple_min(dx, dx2);
-        dx2 = pos_x - x_size;
-        dx2 *= dx2;
-        dx  = simple_min(dx, dx2);
-        dy2 = pos_y + y_size;
-        dy2 *= dy2;
-        dy  = simple_min(dy, dy2 );
-        dy2 = pos_y - y_size;
-        dy2 *= dy2;
-        dy  = simple_min(dy, dy2 );
+    dx = fabs(pos_x - obj2->pos_x);
+    dy = fabs(pos_y - obj2->pos_y);
+    if(periodic){                       // Closest image
+        dx = simple_min(dx, x_size - dx);
+        dy = simple_min(dy, y_size - dy);
     }
-    return sqrt(dx+dy);
+    return sqrt(dx*dx+dy*dy);
 }
 
 /**
@@ -278,8 +273,8 @@ double  object::box_energy(
         x1 = pos_x - sin(orientation)*at1->y_pos + cos(orientation)*at1->x_pos;
         y1 = pos_y + cos(orientation)*at1->y_pos + sin(orientation)*at1->x_pos;
         r  = the_force->size(at1->type);
-        if((x1 < r ) || (x1 > (x_size-r)) ||
-                (y1 < r) || (x1 > (y_size-r))) value += the_force->big_energy;
+        value += the_force->wall_interaction( at1->type,
+                std::min( std::min( x1, x_size - x1 ), std::min( y1, y_size - y1 )) - r );
     }
     return value;
 }
@@ -299,7 +294,12 @@ double  object::box_energy(
         x1 = pos_x - sin(orientation)*at1->y_pos + cos(orientation)*at1->x_pos;
         y1 = pos_y + cos(orientation)*at1->y_pos + sin(orientation)*at1->x_pos;
         r  = the_force->size(at1->type);
-        if(!the_box->is_inside(x1,y1,r)) value += the_force->big_energy;
+        if( the_force->wall_length == 0.0 ){    // Hard walls only
+            if( !the_box->is_inside( x1, y1, r )) value += the_force->big_energy;
+        } else {
+            value += the_force->wall_interaction( at1->type,
+                    the_box->wall_distance( x1, y1, r + the_force->wall_length ) - r );
+        }
     }
     return value;
 }
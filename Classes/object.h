@@ -58,6 +58,8 @@ public:
     int  obj_n_rotation;		     ///<  number of rotation for this object.
     int  obj_n_translation;		     ///<  number of translation of an object.
     float  obj_dl_max;  		     ///<  individual dl_max of the object. 
+    int  obj_epoch;			     ///<  config epoch in which obj_dl_max was set, see config::reset_obj_dl_max().
+    int  obj_id;			     ///<  position of the object when read or added, kept by config::sort_objects().
     
 private:
     double  saved_energy;                   ///< Short cut if no need to recalculate
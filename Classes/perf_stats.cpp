@@ -0,0 +1,79 @@
+/**
+ * @file    perf_stats.cpp
+ *
+ * Implementation of the integration timers and counters.
+ */
+
+#include "perf_stats.h"
+#include <boost/format.hpp>
+
+using boost::format;
+
+static const char *phase_names[perf_stats::N_PHASES] = { "move", "energy", "accept", "I/O" };
+
+/**
+ * Constructor with all the counters and timers at zero and the timers
+ * disabled.
+ */
+perf_stats::perf_stats(){
+    enabled = false;
+    reset();
+}
+
+/**
+ * Set all the counters and timers to zero, leaving them enabled or not.
+ */
+void
+perf_stats::reset(){
+    for( int p = 0; p < N_PHASES; p++ ) seconds[p] = 0.0;
+    n_steps      = 0;
+    n_pairs      = 0;
+    n_cut_off    = 0;
+    n_atom_pairs = 0;
+    n_rebuilds   = 0;
+    n_sorts      = 0;
+    last         = std::chrono::steady_clock::now();
+}
+
+/**
+ * The statistics accumulated since an earlier copy was taken.
+ * @param earlier a copy of these statistics taken earlier.
+ * @return the difference.
+ */
+perf_stats
+perf_stats::since(const perf_stats& earlier) const {
+    perf_stats  diff( *this );
+
+    for( int p = 0; p < N_PHASES; p++ ) diff.seconds[p] -= earlier.seconds[p];
+    diff.n_steps      -= earlier.n_steps;
+    diff.n_pairs      -= earlier.n_pairs;
+    diff.n_cut_off    -= earlier.n_cut_off;
+    diff.n_atom_pairs -= earlier.n_atom_pairs;
+    diff.n_rebuilds   -= earlier.n_rebuilds;
+    diff.n_sorts      -= earlier.n_sorts;
+    return diff;
+}
+
+/**
+ * Write the statistics as two lines, the timers (if enabled) with their
+ * share of the total, and the counters with their rate per step.
+ * @param dest the stream to write to.
+ */
+void
+perf_stats::write(std::ostream& dest) const {
+    double  total = 0.0;
+    double  per_step = ( n_steps > 0 ) ? 1.0 / n_steps : 0.0;
+
+    if( enabled ){
+        for( int p = 0; p < N_PHASES; p++ ) total += seconds[p];
+        dest << "Time";
+        for( int p = 0; p < N_PHASES; p++ )
+            dest << format(" %s %.4g s (%.1f%%)%s") % phase_names[p] % seconds[p]
+                    % ( total > 0.0 ? 100.0 * seconds[p] / total : 0.0 )
+                    % (( p < N_PHASES - 1 ) ? "," : "");
+        dest << "\n";
+    }
+    dest << format("Steps %ld, pairs %ld (%.4g per step), cut off %ld, atom pairs %ld (%.4g per step), rebuilds %ld, sorts %ld\n")
+            % n_steps % n_pairs % ( n_pairs * per_step ) % n_cut_off
+            % n_atom_pairs % ( n_atom_pairs * per_step ) % n_rebuilds % n_sorts;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file    perf_stats.h
+ * @brief   Header file for the perf_stats class.
+ *
+ * @class   perf_stats perf_stats.h
+ * @brief   Timers and counters describing where an integration spends its time.
+ *
+ * The counters are always kept, they are updated once per object and cost
+ * nothing noticeable:
+ * * n_steps, the integration steps made,
+ * * n_pairs, the pairs of objects examined by config::energy(),
+ * * n_cut_off, the pairs among those rejected as too far apart to interact,
+ * * n_atom_pairs, the pairs of atoms whose interaction was evaluated,
+ * * n_rebuilds, the cell lists built by config::build_grid(),
+ * * n_sorts, the reorderings of the objects by config::sort_objects().
+ *
+ * The timers only run when 'enabled' is set. The time between mark() and
+ * the following charge(phase), or between two calls of charge(), is
+ * added to the phase, so a sequence of phases costs one clock reading per
+ * phase.
+ *
+ * A single instance, config::stats, is shared by the configurations and
+ * integrators of a programme. Reports over an interval are obtained by
+ * keeping a copy of the statistics and writing the difference, since().
+ */
+
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <chrono>
+#include <iostream>
+
+class perf_stats {
+public:
+    /// The phases of an integration that are timed.
+    enum phase { MOVE, ENERGY, ACCEPT, IO, N_PHASES };
+
+    perf_stats();                           ///< Constructor, everything zero and disabled.
+    void    reset();                        ///< Set the counters and timers to zero.
+    perf_stats since(const perf_stats& earlier
+                     ) const;               ///< The statistics accumulated after 'earlier'.
+    void    write(std::ostream& dest
+                  ) const;                  ///< Write a report of the statistics.
+
+    /// Start timing, the next charge() counts from here.
+    inline void mark(){
+        if( enabled ) last = std::chrono::steady_clock::now();
+    }
+    /// Add the time since the last mark() or charge() to a phase.
+    inline void charge(phase p){
+        if( !enabled ) return;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        seconds[p] += std::chrono::duration<double>( now - last ).count();
+        last = now;
+    }
+
+    bool    enabled;                        ///< Run the timers.
+    double  seconds[N_PHASES];              ///< Time spent in each phase.
+    long    n_steps;                        ///< Integration steps made.
+    long    n_pairs;                        ///< Pairs of objects examined for the energy.
+    long    n_cut_off;                      ///< Pairs of objects too far apart to interact.
+    long    n_atom_pairs;                   ///< Pairs of atoms whose interaction was evaluated.
+    long    n_rebuilds;                     ///< Cell lists built.
+    long    n_sorts;                        ///< Reorderings of the objects in memory.
+
+private:
+    std::chrono::steady_clock::time_point last;   ///< Time of the last mark() or charge().
+};
+
+#endif /* PERF_STATS_H */
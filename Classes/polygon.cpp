@@ -15,6 +15,16 @@
 #include "polygon.h"
 #include <boost/format.hpp>
 #include <math.h>
+#include <vector>
+#include <algorithm>
+
+#define POLYGON_GRID    64      // Cells along the longer side of the query grid
+#define CELL_UNKNOWN    0
+#define CELL_INSIDE     1
+#define CELL_OUTSIDE    2
+#define CELL_EDGE       3
+
+long    polygon::n_grid_builds = 0;
 
 // TODO it would be nice if with points we could do some other
 // operations like: +, -, dot(), and other vector operators
@@ -52,6 +62,7 @@ polygon::polygon( polygon *orig ){
         _vertices[i].x = orig->_vertices[i].x;
         _vertices[i].y = orig->_vertices[i].y;
     }
+    grid = orig->grid;                  // Shared if built, orig is only read
 }
 
 polygon::~polygon(){
@@ -73,6 +84,7 @@ polygon::add_vertex( double x_val, double y_val ){
     _vertices[n_vertex].x = x_val;
     _vertices[n_vertex].y = y_val;
     n_vertex++;
+    drop_grid();
 }
 
 void
@@ -81,6 +93,7 @@ polygon::expand( double scale ){
         _vertices[i].x *= scale;
         _vertices[i].y *= scale;
     }
+    drop_grid();
 }
 
 double
@@ -168,7 +181,7 @@ polygon::center_y()
 }
 
 bool
-polygon::is_inside( double x, double y )
+polygon::crossing_test( double x, double y )
 {
     bool    l_test = false;		// Test both left and right rays to resolve
     bool    r_test = false;		// Edge issues... also need to handle 
@@ -191,16 +204,196 @@ polygon::is_inside( double x, double y )
     return ( l_test || r_test );
 }
 
+/**
+ * Segment against box test (Liang-Barsky clipping).
+ * @return true if the segment from a to b meets the box.
+ */
+static bool
+segment_meets_box( Point a, Point b, double x0, double y0, double x1, double y1 ){
+    double  t0 = 0.0, t1 = 1.0;
+    double  p[4] = { a.x - b.x, b.x - a.x, a.y - b.y, b.y - a.y };
+    double  q[4] = { a.x - x0, x1 - a.x, a.y - y0, y1 - a.y };
+
+    for( int k = 0; k < 4; k++ ){
+        if( p[k] == 0.0 ){
+            if( q[k] < 0.0 ) return false;     // parallel and outside
+        } else {
+            double t = q[k] / p[k];
+            if( p[k] < 0.0 ){
+                if( t > t1 ) return false;
+                if( t > t0 ) t0 = t;
+            } else {
+                if( t < t0 ) return false;
+                if( t < t1 ) t1 = t;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Build the query grid. Cells that an edge touches (with a small margin
+ * for rounding) are edge cells, every other cell lies wholly inside or
+ * outside and a run of them along a row is classified by one crossing
+ * test. The clearance of a cell is the distance it is guaranteed to
+ * keep from the edges, from its Chebyshev distance to the nearest edge
+ * cell.
+ */
+void
+polygon::build_grid(){
+    polygon_grid& g = the_grid();
+
+    n_grid_builds++;
+    g.x0 = x_min();
+    g.y0 = y_min();
+    g.x1 = x_max();
+    g.y1 = y_max();
+    g.h = std::max( g.x1 - g.x0, g.y1 - g.y0 ) / POLYGON_GRID;
+    if( g.h <= 0.0 ) g.h = 1.0;
+    g.nx = std::max( 1, (int)ceil(( g.x1 - g.x0 ) / g.h ));
+    g.ny = std::max( 1, (int)ceil(( g.y1 - g.y0 ) / g.h ));
+    g.cell_state.assign( g.nx * g.ny, CELL_UNKNOWN );
+    g.clearance.assign( g.nx * g.ny, 0.0 );
+
+    double margin = 1e-9 * ( g.h * POLYGON_GRID + fabs( g.x0 ) + fabs( g.y0 ));
+    for( int i = 0; i < n_vertex; i++ ){
+        Point a = _vertices[i];
+        Point b = _vertices[(i + 1)%n_vertex];
+        int k0 = std::max( 0, (int)floor(( std::min( a.x, b.x ) - margin - g.x0 ) / g.h ));
+        int k1 = std::min( g.nx - 1, (int)floor(( std::max( a.x, b.x ) + margin - g.x0 ) / g.h ));
+        int l0 = std::max( 0, (int)floor(( std::min( a.y, b.y ) - margin - g.y0 ) / g.h ));
+        int l1 = std::min( g.ny - 1, (int)floor(( std::max( a.y, b.y ) + margin - g.y0 ) / g.h ));
+        for( int l = l0; l <= l1; l++ )
+            for( int k = k0; k <= k1; k++ ){
+                double x = g.x0 + k * g.h;
+                double y = g.y0 + l * g.h;
+                if( segment_meets_box( a, b, x - margin, y - margin,
+                            x + g.h + margin, y + g.h + margin ))
+                    g.cell_state[ l * g.nx + k ] = CELL_EDGE;
+            }
+    }
+
+    for( int l = 0; l < g.ny; l++ ){
+        double y = g.y0 + ( l + 0.5 ) * g.h;
+        for( int i = 0; i < n_vertex; i++ )     // The crossing test is unreliable
+            if( _vertices[i].y == y ){          // level with a vertex.
+                y += 0.25 * g.h;
+                break;
+            }
+        signed char state = CELL_UNKNOWN;
+        for( int k = 0; k < g.nx; k++ ){
+            signed char& cell = g.cell_state[ l * g.nx + k ];
+            if( cell == CELL_EDGE ){
+                state = CELL_UNKNOWN;
+            } else {
+                if( state == CELL_UNKNOWN )
+                    state = crossing_test( g.x0 + ( k + 0.5 ) * g.h, y ) ? CELL_INSIDE : CELL_OUTSIDE;
+                cell = state;
+            }
+        }
+    }
+
+    std::vector<int> front, next_front;         // Breadth first from the edge cells
+    std::vector<int> rank( g.nx * g.ny, -1 );
+    for( int c = 0; c < g.nx * g.ny; c++ )
+        if( g.cell_state[c] == CELL_EDGE ){
+            rank[c] = 0;
+            front.push_back( c );
+        }
+    for( int d = 1; !front.empty(); d++ ){
+        next_front.clear();
+        for( int c : front ){
+            int k = c % g.nx;
+            int l = c / g.nx;
+            for( int m = std::max( 0, l - 1 ); m <= std::min( g.ny - 1, l + 1 ); m++ )
+                for( int j = std::max( 0, k - 1 ); j <= std::min( g.nx - 1, k + 1 ); j++ ){
+                    int n = m * g.nx + j;
+                    if( rank[n] < 0 ){
+                        rank[n] = d;
+                        g.clearance[n] = ( d - 1 ) * g.h;
+                        next_front.push_back( n );
+                    }
+                }
+        }
+        front.swap( next_front );
+    }
+}
+
+void
+polygon::drop_grid(){
+    grid.reset();                       // Copies keep the grid of their vertices
+}
+
+polygon_grid&
+polygon::the_grid(){
+    if( !grid ) grid = std::make_shared<polygon_grid>();
+    return *grid;
+}
+
+/**
+ * Signed distance at each node of the query grid, the nodes being the
+ * corners of the cells.
+ */
+void
+polygon::build_distance(){
+    polygon_grid& g = the_grid();
+
+    n_grid_builds++;
+    if( g.cell_state.empty() ) build_grid();
+    g.node_distance.resize(( g.nx + 1 ) * ( g.ny + 1 ));
+    for( int l = 0; l <= g.ny; l++ )
+        for( int k = 0; k <= g.nx; k++ )
+            g.node_distance[ l * ( g.nx + 1 ) + k ] =
+                signed_distance( g.x0 + k * g.h, g.y0 + l * g.h );
+}
+
+int
+polygon::grid_cell( double x, double y ){
+    polygon_grid& g = the_grid();
+    if( g.cell_state.empty() ) build_grid();
+    if( !(( x >= g.x0 ) && ( x <= g.x1 ) && ( y >= g.y0 ) && ( y <= g.y1 )))
+        return -1;
+    int k = std::min( g.nx - 1, (int)(( x - g.x0 ) / g.h ));
+    int l = std::min( g.ny - 1, (int)(( y - g.y0 ) / g.h ));
+    return l * g.nx + k;
+}
+
+bool
+polygon::is_inside( double x, double y )
+{
+    if( n_vertex < 3 ) return crossing_test( x, y );
+    polygon_grid& g = the_grid();
+    int c = grid_cell( x, y );
+    if( c < 0 ) return false;
+    if( g.cell_state[c] == CELL_EDGE ) return crossing_test( x, y );
+    return( g.cell_state[c] == CELL_INSIDE );
+}
+
 bool
 polygon::is_inside( double x, double y, double radius )
 {
-    bool     test = is_inside( x, y );
+    bool     test;
     int      i = 0;
     double   t;
     double   dist;
     Point    fixed = Point(x, y);
     Point    projection = Point();
 
+    if( n_vertex < 3 ) return false;
+    polygon_grid& g = the_grid();
+    int c = grid_cell( x, y );
+    if( c < 0 ) return false;
+    switch( g.cell_state[c] ){
+    case CELL_OUTSIDE:
+        return false;
+    case CELL_INSIDE:
+        if( radius <= g.clearance[c] ) return true;
+        test = true;
+        break;
+    default:
+        test = crossing_test( x, y );
+    }
+
     while( test && (i < n_vertex)){
         Point curr = _vertices[i];
         Point next = _vertices[(i + 1)%n_vertex];
@@ -220,6 +413,51 @@ polygon::is_inside( double x, double y, double radius )
     return test;
 }
 
+double
+polygon::signed_distance( double x, double y )
+{
+    double  d2 = HUGE_VAL;
+    Point   fixed = Point(x, y);
+
+    for( int i = 0; i < n_vertex; i++ ){
+        Point curr = _vertices[i];
+        Point next = _vertices[(i + 1)%n_vertex];
+        double l2 = distance2( next, curr );
+        double t  = 0.0;
+        if( l2 > 0.0 ){
+            t = ((fixed.x - curr.x) * (next.x - curr.x) + (fixed.y - curr.y) * (next.y - curr.y)) / l2;
+            t = (t<0.0)?0.0:((t>1.0)?1.0:t);
+        }
+        Point projection = Point( curr.x + t * (next.x - curr.x), curr.y + t * (next.y - curr.y) );
+        d2 = std::min( d2, distance2( fixed, projection ));
+    }
+    return is_inside( x, y ) ? sqrt( d2 ) : -sqrt( d2 );
+}
+
+/**
+ * Signed distance to the boundary for wall interactions. The distance
+ * is exact whenever it is below limit, larger distances may be replaced
+ * by any lower bound that is itself at least limit.
+ * @param limit the range beyond which the exact distance is not needed.
+ */
+double
+polygon::wall_distance( double x, double y, double limit )
+{
+    if( n_vertex < 3 ) return signed_distance( x, y );
+    polygon_grid& g = the_grid();
+    if( g.node_distance.empty() ) build_distance();
+    double u = ( x - g.x0 ) / g.h;
+    double v = ( y - g.y0 ) / g.h;
+    if(( u >= 0.0 ) && ( u <= g.nx ) && ( v >= 0.0 ) && ( v <= g.ny )){
+        int k = (int)( u + 0.5 );
+        int l = (int)( v + 0.5 );
+        double bound = g.node_distance[ l * ( g.nx + 1 ) + k ]
+            - hypot( x - g.x0 - k * g.h, y - g.y0 - l * g.h );
+        if( bound >= limit ) return bound;
+    }
+    return signed_distance( x, y );
+}
+
 bool
 polygon::is_inside( polygon* other )
 {
@@ -275,6 +513,8 @@ polygon::order_vertices(){
     int    index = 0;
     int	   i;
     double min_y = _vertices[0].y;
+
+    drop_grid();
     double x_val = _vertices[0].x;
 
     for( i=1; i < n_vertex; i++ ){
@@ -316,6 +556,7 @@ polygon::translate( double dx, double dy ){
         _vertices[i].x += dx;
         _vertices[i].y += dy;
     }
+    drop_grid();
 }
 
 void
@@ -329,6 +570,128 @@ polygon::rotate( double angle ){	/// Do a clockwise rotation of angle.
         _vertices[i].x = x_new;
         _vertices[i].y = y_new;
     }
+    drop_grid();
+}
+
+/**
+ * Signed area of the intersection of a disc centred on the origin with
+ * the triangle formed by the origin and the points a and b.
+ * The segment ab is cut where it crosses the circle, the pieces inside
+ * contribute a triangle and those outside a circular sector.
+ */
+static double
+triangle_circle_area( Point a, Point b, double r ){
+    double	dx = b.x - a.x;
+    double	dy = b.y - a.y;
+    double	qa = dx * dx + dy * dy;
+    double	t[4] = { 0.0, 0.0, 0.0, 1.0 };
+    int		n_t = 1;
+    double	area = 0.0;
+
+    if( qa == 0.0 ) return 0.0;
+    double qb   = a.x * dx + a.y * dy;
+    double qc   = a.x * a.x + a.y * a.y - r * r;
+    double disc = qb * qb - qa * qc;
+    if( disc > 0.0 ){				// Line crosses circle
+        double root = sqrt( disc );
+        double t1 = ( -qb - root ) / qa;
+        double t2 = ( -qb + root ) / qa;
+        if(( t1 > 0.0 ) && ( t1 < 1.0 )) t[n_t++] = t1;
+        if(( t2 > 0.0 ) && ( t2 < 1.0 )) t[n_t++] = t2;
+    }
+    t[n_t] = 1.0;
+    for( int i = 0; i < n_t; i++ ){
+        Point p = Point( a.x + t[i] * dx, a.y + t[i] * dy );
+        Point q = Point( a.x + t[i+1] * dx, a.y + t[i+1] * dy );
+        double tm = 0.5 * ( t[i] + t[i+1] );
+        double mx = a.x + tm * dx;
+        double my = a.y + tm * dy;
+        double cross = p.x * q.y - p.y * q.x;
+        if( mx * mx + my * my < r * r )	// Piece inside the circle
+            area += 0.5 * cross;
+        else					// Piece outside, take the sector
+            area += 0.5 * r * r * atan2( cross, p.x * q.x + p.y * q.y );
+    }
+    return area;
+}
+
+/**
+ * Exact area of the intersection of the polygon and a disc.
+ * @param x, y the centre of the disc.
+ * @param r the radius of the disc.
+ * The polygon can have any winding and need not be convex.
+ */
+double
+polygon::circle_area( double x, double y, double r ){
+    double area = 0.0;
+
+    if( r <= 0.0 ) return 0.0;
+    for( int i = 0; i < n_vertex; i++ ){
+        Point curr = _vertices[i];
+        Point next = _vertices[(i + 1)%n_vertex];
+        area += triangle_circle_area( Point( curr.x - x, curr.y - y ),
+                                      Point( next.x - x, next.y - y ), r );
+    }
+    return fabs( area );
+}
+
+/**
+ * Exact area of the intersection of the polygon and a convex window.
+ * @param window the vertices of a convex polygon (either winding).
+ * @param n_window the number of vertices in window.
+ * The polygon is clipped successively by each edge of the window
+ * (Sutherland-Hodgman), this is correct for non-convex polygons as
+ * the degenerate edges that can appear contribute no area.
+ */
+double
+polygon::clip_area( const Point *window, int n_window ){
+    std::vector<Point>	in( _vertices, _vertices + n_vertex );
+    std::vector<Point>	out;
+    double		sense = 0.0;		// Orientation of the window
+
+    for( int i = 0; i < n_window; i++ ){
+        Point curr = window[i];
+        Point next = window[(i + 1)%n_window];
+        sense += curr.x * next.y - next.x * curr.y;
+    }
+    sense = ( sense < 0.0 ) ? -1.0 : 1.0;
+
+    for( int i = 0; ( i < n_window ) && !in.empty(); i++ ){
+        Point  a  = window[i];
+        Point  b  = window[(i + 1)%n_window];
+        double ex = b.x - a.x;
+        double ey = b.y - a.y;
+        out.clear();
+        for( size_t j = 0; j < in.size(); j++ ){
+            Point  p  = in[j];
+            Point  q  = in[(j + 1)%in.size()];
+            double sp = sense * ( ex * ( p.y - a.y ) - ey * ( p.x - a.x ));
+            double sq = sense * ( ex * ( q.y - a.y ) - ey * ( q.x - a.x ));
+            if( sp >= 0.0 ) out.push_back( p );
+            if(( sp >= 0.0 ) != ( sq >= 0.0 )){	// Edge crosses the window edge
+                double t = sp / ( sp - sq );
+                out.push_back( Point( p.x + t * ( q.x - p.x ), p.y + t * ( q.y - p.y )));
+            }
+        }
+        in.swap( out );
+    }
+
+    double area = 0.0;
+    for( size_t j = 0; j < in.size(); j++ ){
+        Point curr = in[j];
+        Point next = in[(j + 1)%in.size()];
+        area += curr.x * next.y - next.x * curr.y;
+    }
+    return fabs( area / 2.0 );
+}
+
+bool
+polygon::is_same( polygon* other ){
+    if( other->n_vertex != n_vertex ) return false;
+    for( int i = 0; i < n_vertex; i++ )
+        if(( _vertices[i].x != other->_vertices[i].x ) || ( _vertices[i].y != other->_vertices[i].y ))
+            return false;
+    return true;
 }
 
 const Point
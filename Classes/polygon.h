@@ -7,6 +7,23 @@
  *
  * @class       polygon polygon.h
  * @brief       The polygon class.
+ *
+ * Point in polygon queries go through a coarse grid over the bounding
+ * box whose cells are classified as inside, outside or crossed by an
+ * edge. Only points in edge cells need the exact crossing test, and
+ * the distance from inside cells to the nearest edge cell answers most
+ * is_inside(x, y, radius) queries without looking at the edges.
+ * The grid is built on the first query after the vertices change, so
+ * that first query must not be made concurrently from several threads.
+ * A copy shares the grid of the original if it is already built (until
+ * the vertices of either change), copying never modifies the original.
+ * To share one grid between copies made concurrently, query the original
+ * once before making them.
+ *
+ * The signed distance to the boundary at the nodes of the same grid is
+ * kept for wall_distance(), which only measures the distance exactly
+ * for points near the wall: the distance changes no faster than the
+ * position, so the value at the nearest node bounds it elsewhere.
  */
 
 #ifndef POLYGON_H
@@ -14,6 +31,8 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <vector>
+#include <memory>
 
 using namespace std;
 
@@ -25,6 +44,17 @@ typedef struct Point {
     { x = x_val; y = y_val; }
 } Point;
 
+/// Query grid and signed distance field of a polygon.
+struct polygon_grid {
+    std::vector<signed char> cell_state;	///< Inside, outside or edge, empty if not built
+    std::vector<double> clearance;	///< Minimum distance from an inside cell to an edge
+    std::vector<double> node_distance;	///< Signed distance at the grid nodes, empty if not built
+    double  x0, y0;			///< Corner of the grid (bounding box)
+    double  x1, y1;
+    double  h;				///< Side of a cell
+    int     nx, ny;
+};
+
 class polygon {
 public:
     polygon();
@@ -53,6 +83,16 @@ public:
     bool    is_inside( double x, double y );
     bool    is_inside( double x, double y, double radius );
     bool    is_inside( polygon* other );
+    double  signed_distance( double x,	///< Signed distance to the boundary, positive inside
+		double y );
+    double  wall_distance( double x,	///< Signed distance when below limit, else a bound above limit
+		double y, double limit );
+
+    double  circle_area( double x,	///< Area of the polygon within r of (x,y)
+		double y, double r );
+    double  clip_area( const Point *window,	///< Area of the polygon inside a convex window
+		int n_window );
+    bool    is_same( polygon* other );	///< Same vertices in the same order
 
     bool    is_parallelogram(); ///< Test if (JS 24/1/20)
     int     winding();			///< Return +ve for CW winding, -ve for CCW winding
@@ -65,9 +105,23 @@ public:
     int     n_vertex;
     const Point   get_vertex(int i);  ///< Retrieve data (JS 24/1/20)
 
+    static long n_grid_builds;		///< Query grids and distance fields built so far
+
 private:
     int     n_alloc;
     Point*  _vertices;
+
+    bool    crossing_test( double x,	///< Exact ray crossing test
+		double y );
+    void    build_grid();		///< Classify the cells of the query grid
+    void    build_distance();		///< Signed distances at the grid nodes
+    void    drop_grid();		///< Forget the grid when the vertices change
+    int     grid_cell( double x,	///< Grid cell holding (x,y), -1 outside the bounding box
+		double y );
+
+    polygon_grid& the_grid();		///< The grid, possibly not yet built
+
+    std::shared_ptr<polygon_grid> grid;	///< Shared with the copies, NULL when dropped
 };
 
 #endif
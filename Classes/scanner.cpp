@@ -0,0 +1,208 @@
+/**
+ * @file    scanner.cpp
+ * @brief   Implementation of the scanner class.
+ */
+
+#include "scanner.h"
+#include <charconv>
+#include <cstring>
+#include <ctype.h>
+#include <fstream>
+#include <stdexcept>
+
+#define COMMENTCHAR '#'
+
+/**
+ * Read a whole named file into memory. The file need not be seekable
+ * (a pipe such as /dev/stdin), its size is then unknown and it is read
+ * in chunks until its end.
+ * @param filename the file to read.
+ */
+scanner::scanner(const char *filename){
+    std::ifstream ff(filename, std::ios::in | std::ios::binary);
+    char    chunk[65536];
+
+    if( ff.fail() )
+        throw std::runtime_error(std::string("Could not open file ") + filename + "\n");
+    ff.seekg(0, std::ios::end);
+    std::streamoff size = ff.tellg();       // -1 when the size is unknown
+    if( size > 0 ) buffer.reserve( size );
+    ff.clear();                             // Seeking fails on a pipe, which is
+    ff.seekg(0, std::ios::beg);             // still at its start.
+    ff.clear();
+    while( ff.read( chunk, sizeof(chunk) ) || ( ff.gcount() > 0 ))
+        buffer.append( chunk, ff.gcount() );
+    stream     = (std::istream *)NULL;
+    name       = filename;
+    next       = 0;
+    line_start = line_end = cursor = buffer.c_str();
+    n_line     = 0;
+}
+
+/**
+ * Read the remainder of an open FILE into memory.
+ * @param source a FILE opened for reading.
+ * @param label a name for the source used in error messages.
+ */
+scanner::scanner(FILE *source, const char *label){
+    char    chunk[65536];
+    size_t  n_read;
+
+    while(( n_read = fread( chunk, 1, sizeof(chunk), source )) > 0 )
+        buffer.append( chunk, n_read );
+    stream     = (std::istream *)NULL;
+    name       = label;
+    next       = 0;
+    line_start = line_end = cursor = buffer.c_str();
+    n_line     = 0;
+}
+
+/**
+ * Scan a stream, taking lines only as they are needed.
+ * @param source the input stream.
+ * @param label a name for the source used in error messages.
+ */
+scanner::scanner(std::istream& source, const char *label){
+    if( source.fail() )
+        throw std::runtime_error(std::string("Could not read from ") + label + "\n");
+    stream     = &source;
+    name       = label;
+    next       = 0;
+    line_start = line_end = cursor = buffer.c_str();
+    n_line     = 0;
+}
+
+scanner::~scanner(){
+}
+
+/**
+ * Set the current line, removing any comment and trailing white space.
+ */
+void
+scanner::set_line(const char *start, const char *stop){
+    const char *comment = (const char *)memchr( start, COMMENTCHAR, stop - start );
+
+    if( comment ) stop = comment;
+    while(( stop > start ) && isspace( (unsigned char)stop[-1] )) stop--;
+    line_start = start;
+    line_end   = stop;
+    cursor     = start;
+    n_line++;
+}
+
+/**
+ * Advance to the next line that contains something other than white space
+ * and comments.
+ * @return true if a line was found, false at the end of the input.
+ */
+bool
+scanner::next_line(){
+    do {
+        if( stream ){
+            if( !std::getline( *stream, buffer )) return false;
+            set_line( buffer.c_str(), buffer.c_str() + buffer.size() );
+        } else {
+            if( next >= buffer.size() ) return false;
+            const char *start = buffer.c_str() + next;
+            const char *stop  = (const char *)memchr( start, '\n', buffer.size() - next );
+            if( !stop ) stop = buffer.c_str() + buffer.size();
+            next = ( stop - buffer.c_str() ) + 1;
+            set_line( start, stop );
+        }
+        skip_blanks();
+    } while( cursor == line_end );
+    return true;
+}
+
+void
+scanner::skip_blanks(){
+    while(( cursor < line_end ) && isspace( (unsigned char)*cursor )) cursor++;
+}
+
+bool
+scanner::end_of_line(){
+    skip_blanks();
+    return( cursor == line_end );
+}
+
+int
+scanner::line_number(){
+    return n_line;
+}
+
+/**
+ * Throw a runtime_error locating the current position.
+ * @param message what was wrong.
+ */
+void
+scanner::error(const std::string& message){
+    throw std::runtime_error( name + ":" + std::to_string(n_line) + ":"
+                + std::to_string( 1 + (cursor - line_start) ) + ": " + message + "\n" );
+}
+
+bool
+scanner::try_int(int *value){
+    skip_blanks();
+    const char *start = cursor;
+    if(( start < line_end ) && ( *start == '+' )) start++;
+    auto result = std::from_chars( start, line_end, *value );
+    if(( result.ec != std::errc() ) ||
+       (( result.ptr < line_end ) && !isspace( (unsigned char)*result.ptr ))) return false;
+    cursor = result.ptr;
+    return true;
+}
+
+bool
+scanner::try_double(double *value){
+    skip_blanks();
+    const char *start = cursor;
+    if(( start < line_end ) && ( *start == '+' )) start++;
+    auto result = std::from_chars( start, line_end, *value );
+    if(( result.ec != std::errc() ) ||
+       (( result.ptr < line_end ) && !isspace( (unsigned char)*result.ptr ))) return false;
+    cursor = result.ptr;
+    return true;
+}
+
+/**
+ * @param what description of the expected field for error messages.
+ * @return the value of the field.
+ */
+int
+scanner::get_int(const char *what){
+    int value = 0;
+    if( end_of_line() ) error( std::string("missing ") + what );
+    if( !try_int( &value )) error( std::string("expected an integer for ") + what );
+    return value;
+}
+
+double
+scanner::get_double(const char *what){
+    double value = 0.0;
+    if( end_of_line() ) error( std::string("missing ") + what );
+    if( !try_double( &value )) error( std::string("expected a number for ") + what );
+    return value;
+}
+
+std::string
+scanner::get_word(const char *what){
+    if( end_of_line() ) error( std::string("missing ") + what );
+    const char *start = cursor;
+    while(( cursor < line_end ) && !isspace( (unsigned char)*cursor )) cursor++;
+    return std::string( start, cursor - start );
+}
+
+/**
+ * The remaining fields of the line as one string, with the blanks
+ * between them kept and the trailing blanks removed.
+ * @param what description of the expected text for error messages.
+ */
+std::string
+scanner::get_rest(const char *what){
+    if( end_of_line() ) error( std::string("missing ") + what );
+    const char *start = cursor;
+    const char *stop  = line_end;
+    while( isspace( (unsigned char)stop[-1] )) stop--;
+    cursor = line_end;
+    return std::string( start, stop - start );
+}
@@ -0,0 +1,65 @@
+/**
+ * @file    scanner.h
+ * @brief   Header file for the scanner class.
+ *
+ * @class   scanner scanner.h
+ * @brief   A line oriented tokenizer for the text input files.
+ *
+ * The configuration, topology and force field files all share the same
+ * simple structure: lines of white space separated fields, blank lines
+ * are ignored as is anything from a '#' to the end of a line.
+ * The scanner presents such a file one significant line at a time and
+ * converts the fields with std::from_chars, avoiding the construction of
+ * a string stream for each line.
+ *
+ * A named file (or an open FILE) is read into memory in a single
+ * operation and scanned in place. A scanner on a std::istream takes its
+ * lines one at a time instead, so that it only consumes the part of the
+ * stream it needs (as for the successive frames of a trajectory).
+ *
+ * All errors throw a runtime_error, whose message gives the source name,
+ * the line and column where the problem was found and what was expected.
+ */
+
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+
+class scanner {
+public:
+    scanner(const char *filename);          ///< Scan a whole named file.
+    scanner(FILE *source,
+            const char *name);              ///< Scan the rest of an open FILE.
+    scanner(std::istream& source,
+            const char *name);              ///< Scan a stream line by line.
+    virtual ~scanner();
+
+    bool        next_line();                ///< Move to the next significant line, false at the end.
+    bool        end_of_line();              ///< True if no fields remain on the current line.
+    int         get_int(const char *what);  ///< Read an integer field.
+    double      get_double(const char *what);       ///< Read a real number field.
+    std::string get_word(const char *what); ///< Read a field as a string.
+    std::string get_rest(const char *what); ///< Read the rest of the line as a string.
+    bool        try_int(int *value);        ///< Read an integer if there is one.
+    bool        try_double(double *value);  ///< Read a real number if there is one.
+    void        error(const std::string& message);  ///< Throw a runtime_error at the current position.
+    int         line_number();              ///< Number of the current line (from 1).
+
+private:
+    void        skip_blanks();
+    void        set_line(const char *start, const char *stop);
+
+    std::istream *stream;                   ///< Source when reading line by line.
+    std::string buffer;                     ///< Whole file, or current line of a stream.
+    std::string name;                       ///< Name of the source for messages.
+    size_t      next;                       ///< Start of the next line in buffer.
+    const char  *line_start;                ///< Current line.
+    const char  *line_end;                  ///< End of current line (comment removed).
+    const char  *cursor;                    ///< Next character to scan.
+    int         n_line;                     ///< Current line number.
+};
+
+#endif /* SCANNER_H */
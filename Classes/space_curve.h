@@ -0,0 +1,62 @@
+/**
+ * @file    space_curve.h
+ * @brief   Keys ordering the cells of a grid along space filling curves.
+ *
+ * The cells of a 2^bits by 2^bits grid are numbered along a curve that
+ * passes once through each cell, so that cells with close keys are close
+ * in space. Sorting objects by the key of their cell puts neighbours near
+ * each other in a list:
+ * * morton_key() interleaves the bits of x and y (Z order), cheap but
+ *   with long jumps between quadrants,
+ * * hilbert_key() follows the Hilbert curve, each step goes to an adjacent
+ *   cell so neighbourhoods are better preserved.
+ *
+ * See config::curve_keys() for the keys of the objects of a configuration.
+ */
+
+#ifndef SPACE_CURVE_H
+#define SPACE_CURVE_H
+
+/// Number of bits needed for n cells along a direction.
+inline int
+curve_bits(int n){
+    int     bits = 0;
+    while(( 1 << bits ) < n ) bits++;
+    return bits;
+}
+
+/// Position of cell x,y along the Z order curve.
+inline unsigned long
+morton_key(int bits, unsigned long x, unsigned long y){
+    unsigned long key = 0;
+    for( int b = 0; b < bits; b++ ){
+        key |= (( x >> b ) & 1UL ) << ( 2 * b );
+        key |= (( y >> b ) & 1UL ) << ( 2 * b + 1 );
+    }
+    return key;
+}
+
+/// Position of cell x,y along the Hilbert curve through 2^bits by 2^bits cells.
+inline unsigned long
+hilbert_key(int bits, unsigned long x, unsigned long y){
+    unsigned long key = 0;
+    for( unsigned long s = ( 1UL << bits ) >> 1; s > 0; s >>= 1 ){
+        unsigned long rx = ( x & s ) ? 1 : 0;
+        unsigned long ry = ( y & s ) ? 1 : 0;
+        key += s * s * (( 3 * rx ) ^ ry );
+        if( ry == 0 ){                      // Rotate the quadrant
+            if( rx == 1 ){
+                x = s - 1 - ( x & ( s - 1 ));
+                y = s - 1 - ( y & ( s - 1 ));
+            }
+            unsigned long t = x;
+            x = y;
+            y = t;
+        }
+        x &= s - 1;
+        y &= s - 1;
+    }
+    return key;
+}
+
+#endif /* SPACE_CURVE_H */
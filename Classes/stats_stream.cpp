@@ -0,0 +1,84 @@
+/**
+ * @file    stats_stream.cpp
+ *
+ * Implementation of the files of records written for other programmes.
+ */
+
+#include "stats_stream.h"
+#include <boost/format.hpp>
+#include <cmath>
+#include <stdexcept>
+
+using boost::format;
+
+/**
+ * A number as text, values that are not finite (such as an acceptance
+ * ratio with no moves) are written as 'missing', JSON null or an empty
+ * CSV field.
+ */
+static std::string
+number(double value, const char *missing){
+    if( !std::isfinite( value )) return missing;
+    return ( format("%.10g") % value ).str();
+}
+
+/**
+ * Open a file for the records, the format is chosen from the name.
+ * @param name the file name, replaced if it exists.
+ * Throws a runtime_error if the file can not be opened.
+ */
+stats_stream::stats_stream(const std::string& name){
+    csv    = ( name.size() >= 4 ) && ( name.compare( name.size() - 4, 4, ".csv" ) == 0 );
+    header = false;
+    dest.open( name, std::ofstream::out | std::ofstream::trunc );
+    if( !dest.good() )
+        throw std::runtime_error( "Unable to open " + name + " for the statistics\n" );
+}
+
+stats_stream::~stats_stream(){
+    dest.close();
+}
+
+/**
+ * Add a field to the record being built.
+ * @param name the name of the field, a CSV column or a JSON key.
+ * @param value its value.
+ */
+void
+stats_stream::add(const std::string& name, double value){
+    names.push_back( name );
+    values.push_back( value );
+}
+
+/**
+ * Write the record built by add() and start a new one.
+ */
+void
+stats_stream::end_record(){
+    if( csv ){
+        if( !header ){
+            for( size_t k = 0; k < names.size(); k++ )
+                dest << ( k ? "," : "" ) << names[k];
+            dest << "\n";
+            header = true;
+        }
+        for( size_t k = 0; k < values.size(); k++ )
+            dest << ( k ? "," : "" ) << number( values[k], "" );
+    } else {
+        dest << "{";
+        for( size_t k = 0; k < values.size(); k++ )
+            dest << ( k ? ", " : "" ) << "\"" << names[k] << "\": " << number( values[k], "null" );
+        dest << "}";
+    }
+    dest << std::endl;
+    names.clear();
+    values.clear();
+}
+
+/**
+ * @return the number of bytes written to the file so far.
+ */
+long
+stats_stream::n_bytes(){
+    return (long)dest.tellp();
+}
@@ -0,0 +1,43 @@
+/**
+ * @file    stats_stream.h
+ * @brief   Header file for the stats_stream class.
+ *
+ * @class   stats_stream stats_stream.h
+ * @brief   A file of records of named numbers, for other programmes to read.
+ *
+ * Each record is built by calls to add(name, value) and written by
+ * end_record(). The format is chosen from the file name:
+ * * a name ending in .csv gives comma separated values, with a header line
+ *   of the names taken from the first record,
+ * * any other name gives JSON lines, one object per record.
+ *
+ * Every record should have the same fields in the same order. Each record
+ * is flushed so that the file can be followed while a programme runs.
+ */
+
+#ifndef STATS_STREAM_H
+#define STATS_STREAM_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+class stats_stream {
+public:
+    stats_stream(const std::string& name);  ///< Open a named file for writing.
+    virtual ~stats_stream();
+
+    void    add(const std::string& name,
+                double value);              ///< Add a field to the current record.
+    void    end_record();                   ///< Write the current record.
+    long    n_bytes();                      ///< The number of bytes written so far.
+
+private:
+    std::ofstream   dest;
+    bool            csv;                    ///< Comma separated values, else JSON lines.
+    bool            header;                 ///< The CSV header has been written.
+    std::vector<std::string>    names;      ///< Fields of the current record.
+    std::vector<double>         values;
+};
+
+#endif /* STATS_STREAM_H */
@@ -0,0 +1,270 @@
+/**
+ * @file    step_controller.cpp
+ *
+ * Implementation of the controllers that choose the moves of an integrator
+ * and adapt their size to the acceptance.
+ */
+
+#include <math.h>
+#include "step_controller.h"
+#include "integrator.h"
+#include "checkpoint.h"
+#include "common.h"
+#include <algorithm>
+
+#define DL_RESET        2000        // Steps between resets of the object step sizes (legacy).
+#define MIN_SCALE       0.5         // Smallest change of a step size in one adjustment.
+#define MAX_SCALE       2.0         // Largest change of a step size in one adjustment.
+#define MIN_STEP        0.01        // Smallest translation.
+#define MIN_ANGLE       0.001       // Smallest rotation, in radians.
+
+#define LEGACY_TYPE     0           // Controller types in checkpoints.
+#define TARGET_TYPE     1
+
+/**
+ * Constructor, the step sizes are adapted for the whole integration.
+ */
+step_controller::step_controller(){
+    freeze_step = 0;
+    adapt       = true;
+}
+
+step_controller::~step_controller(){
+}
+
+/**
+ * Save the state of the controller, by default there is none.
+ * @param dest  A stream opened for binary writing.
+ */
+void
+step_controller::write_checkpoint(std::ostream& dest){
+}
+
+/**
+ * Restore the state saved by write_checkpoint().
+ * @param src   A stream opened for binary reading.
+ */
+void
+step_controller::read_checkpoint(std::istream& src){
+}
+
+step_controller *
+legacy_controller::clone() const {
+    return new legacy_controller( *this );
+}
+
+int
+legacy_controller::type() const {
+    return LEGACY_TYPE;
+}
+
+/**
+ * Every i_adjust steps scale the global step size of the integrator
+ * according to its acceptance, and every DL_RESET steps reset the step
+ * size of all the objects to the initial step size (truncated, as the
+ * original sweep through set_obj_dl_max() did).
+ */
+void
+legacy_controller::adjust(integrator& mc, config *the_state, int n_step){
+    adapt = adapting( n_step );
+    if( !adapt || ( n_step == 0 )) return;
+    if(( n_step % mc.i_adjust )== 0 ){
+        if(((float)mc.n_good/(mc.n_good+mc.n_bad)) < 0.1) mc.dl_max /= 3.9;
+        if(((float)mc.n_good/(mc.n_good+mc.n_bad)) > 0.7) mc.dl_max *= 3.0;
+        mc.dl_max = simple_min( mc.dl_max, the_state->x_size);
+        mc.dl_max = simple_min( mc.dl_max, the_state->y_size);
+
+        //don't let the dl_max down too much
+        mc.dl_max = simple_max( mc.dl_max, 0.1);
+    }
+    if(( n_step % DL_RESET )== 0 )
+        the_state->reset_obj_dl_max( (int)mc.initial_dl_max );
+}
+
+/**
+ * The first n_try moves of an object use config::primary_move() with the
+ * global step size, later moves config::move_aftern_primary_move() with
+ * the step size of the object.
+ * @return BOTH, the two moves may translate and rotate.
+ */
+int
+legacy_controller::propose(integrator& mc, config *new_state, int obj_number){
+    if(( new_state->objects_ngood(obj_number)+new_state->objects_nbad(obj_number)) < mc.n_try ){
+        new_state->primary_move(obj_number, mc.dl_max, mc.rot_flag);
+    } else {
+        new_state->move_aftern_primary_move(obj_number, mc.rot_flag);
+    }
+    return BOTH;
+}
+
+/**
+ * Count the move in the object tallies and scale the step size of the
+ * object, config::modif_mobility().
+ */
+void
+legacy_controller::tally(integrator& mc, config *the_state, int obj_number,
+        int move_kind, bool accepted){
+    the_state->modif_mobility(obj_number, accepted, mc.initial_dl_max, adapt);
+}
+
+/**
+ * Constructor.
+ * @param target the acceptance aimed for, between 0 and 1.
+ */
+target_controller::target_controller(double target){
+    this->target = target;
+}
+
+step_controller *
+target_controller::clone() const {
+    return new target_controller( *this );
+}
+
+int
+target_controller::type() const {
+    return TARGET_TYPE;
+}
+
+/**
+ * Add the step sizes and tallies of the object types up to o_type. A new
+ * type starts with translations of the initial step size of the integrator
+ * and rotations over the whole symmetry angle, half a turn for an
+ * asymmetric object.
+ */
+void
+target_controller::add_type(integrator& mc, config *the_state, int o_type){
+    while( (int)step[TRANSLATION].size() <= o_type ){
+        int     order = the_state->side_object( step[TRANSLATION].size() );
+        symmetry.push_back( order );
+        step[TRANSLATION].push_back( mc.initial_dl_max );
+        step[ROTATION].push_back( M_PI / std::max( order, 1 ));
+        for( int k = TRANSLATION; k <= ROTATION; k++ ){
+            n_tried[k].push_back( 0 );
+            n_good[k].push_back( 0 );
+        }
+    }
+}
+
+/**
+ * @return the largest translation or rotation of objects of type o_type.
+ */
+double
+target_controller::step_size(int o_type, int move_kind){
+    return step[move_kind].at( o_type );
+}
+
+/**
+ * Every i_adjust steps scale the step size of each kind of move of each
+ * object type by the ratio of its acceptance to the target, limited to
+ * MIN_SCALE..MAX_SCALE, and restart the tallies. Translations are kept
+ * shorter than half the box and rotations within the symmetry angle. The global
+ * step size of the integrator reports the largest translation.
+ */
+void
+target_controller::adjust(integrator& mc, config *the_state, int n_step){
+    double  longest = simple_min( the_state->width(), the_state->height() );
+
+    longest *= 0.5;
+    adapt = adapting( n_step );
+    if(( n_step == 0 ) || (( n_step % mc.i_adjust ) != 0 )) return;
+    for( int k = TRANSLATION; k <= ROTATION; k++ )
+    for( size_t t = 0; t < step[k].size(); t++ ){
+        if( adapt && ( n_tried[k][t] > 0 )){
+            double  scale = (double)n_good[k][t] / n_tried[k][t] / target;
+            scale = simple_max( scale, MIN_SCALE );
+            scale = simple_min( scale, MAX_SCALE );
+            step[k][t] *= scale;
+            if( k == TRANSLATION ){
+                step[k][t] = simple_max( step[k][t], MIN_STEP );
+                step[k][t] = simple_min( step[k][t], longest );
+            } else {
+                step[k][t] = simple_max( step[k][t], MIN_ANGLE );
+                step[k][t] = std::min( step[k][t], M_PI / std::max( symmetry[t], 1 ));
+            }
+        }
+        n_tried[k][t] = n_good[k][t] = 0;
+    }
+    if( !step[TRANSLATION].empty() )
+        mc.dl_max = *std::max_element( step[TRANSLATION].begin(), step[TRANSLATION].end() );
+}
+
+/**
+ * Either translate the object uniformly within a square, or (if the
+ * integrator has rot_flag set and the object is not circular, with equal
+ * probability) rotate it uniformly, using the step sizes of its type. Both
+ * moves are symmetric.
+ * @return the kind of move made.
+ */
+int
+target_controller::propose(integrator& mc, config *new_state, int obj_number){
+    int     o_type = new_state->get_object(obj_number)->o_type;
+    int     move_kind = TRANSLATION;
+
+    add_type( mc, new_state, o_type );
+    if( mc.rot_flag && ( symmetry[o_type] > 0 ) && ( rnd_lin(1.0) < 0.5 )) move_kind = ROTATION;
+    if( move_kind == TRANSLATION ){
+        double  s  = step[TRANSLATION][o_type];
+        double  dx = rnd_lin(2.0*s) - s;
+        double  dy = rnd_lin(2.0*s) - s;
+        new_state->displace(obj_number, dx, dy, 0.0);
+    } else {
+        double  a  = step[ROTATION][o_type];
+        new_state->displace(obj_number, 0.0, 0.0, rnd_lin(2.0*a) - a);
+    }
+    return move_kind;
+}
+
+/**
+ * Count the move for its type and kind, and in the object tallies without
+ * changing the step size of the object.
+ */
+void
+target_controller::tally(integrator& mc, config *the_state, int obj_number,
+        int move_kind, bool accepted){
+    int     o_type = the_state->get_object(obj_number)->o_type;
+
+    n_tried[move_kind][o_type]++;
+    if( accepted ) n_good[move_kind][o_type]++;
+    the_state->modif_mobility(obj_number, accepted, mc.initial_dl_max, false);
+}
+
+/**
+ * Save the step sizes and tallies of each object type.
+ * @param dest  A stream opened for binary writing.
+ */
+void
+target_controller::write_checkpoint(std::ostream& dest){
+    ckpt_put(dest, (int)step[TRANSLATION].size());
+    for( size_t t = 0; t < symmetry.size(); t++ ) ckpt_put(dest, symmetry[t]);
+    for( int k = TRANSLATION; k <= ROTATION; k++ )
+    for( size_t t = 0; t < step[k].size(); t++ ){
+        ckpt_put(dest, step[k][t]);
+        ckpt_put(dest, n_tried[k][t]);
+        ckpt_put(dest, n_good[k][t]);
+    }
+}
+
+/**
+ * Restore the step sizes and tallies saved by write_checkpoint(), the
+ * target and freeze_step are kept.
+ * @param src   A stream opened for binary reading.
+ */
+void
+target_controller::read_checkpoint(std::istream& src){
+    int     n_types;
+
+    ckpt_get(src, n_types);
+    if( n_types < 0 ) throw std::runtime_error("Checkpoint file is corrupted\n");
+    symmetry.resize( n_types );
+    for( int t = 0; t < n_types; t++ ) ckpt_get(src, symmetry[t]);
+    for( int k = TRANSLATION; k <= ROTATION; k++ ){
+        step[k].resize( n_types );
+        n_tried[k].resize( n_types );
+        n_good[k].resize( n_types );
+        for( int t = 0; t < n_types; t++ ){
+            ckpt_get(src, step[k][t]);
+            ckpt_get(src, n_tried[k][t]);
+            ckpt_get(src, n_good[k][t]);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file    step_controller.h
+ * @brief   Header file for the step_controller classes.
+ *
+ * @class   step_controller step_controller.h
+ * @brief   Chooses the moves made by an integrator and adapts their size.
+ *
+ * At each step of integrator::run() the controller is asked to:
+ * * adjust(mc, state, n_step) update its step sizes, before the step,
+ * * propose(mc, new_state, obj) move object obj in the copy of the
+ *              configuration, returning the kind of move made,
+ * * tally(mc, state, obj, kind, accepted) record the outcome of the move.
+ *
+ * Once the integrator has made freeze_step steps (if freeze_step is
+ * positive) the step sizes are no longer changed. Adapting the moves to
+ * the acceptance breaks detailed balance, so it should only be done while
+ * equilibrating.
+ *
+ * Two controllers are provided:
+ * * legacy_controller, the original behaviour: a global dl_max scaled by
+ *              3.0 or 1/3.9 when the acceptance leaves 0.1..0.7, and the
+ *              per-object step sizes of config::modif_mobility() reset
+ *              every DL_RESET steps.
+ * * target_controller, uniform translations and rotations whose size is
+ *              kept for each object type and kind of move, and scaled every
+ *              i_adjust steps to bring the acceptance towards a target.
+ *              Rotations stay within the symmetry angle of the object type
+ *              and circular objects are only translated.
+ *
+ * A controller saves its state in the integrator checkpoint.
+ */
+
+#ifndef STEP_CONTROLLER_H
+#define STEP_CONTROLLER_H
+
+#include "config.h"
+#include <iostream>
+#include <vector>
+
+class integrator;
+
+class step_controller {
+public:
+    /// The kinds of move.
+    enum kind { TRANSLATION, ROTATION, BOTH };
+
+    step_controller();                      ///< Constructor, never frozen.
+    virtual ~step_controller();
+    virtual step_controller *clone() const = 0;    ///< A copy of the controller.
+    virtual int     type() const = 0;       ///< Identifies the controller in checkpoints.
+
+    virtual void    adjust(integrator& mc, config *the_state,
+                           int n_step) = 0; ///< Adapt the step sizes before a step.
+    virtual int     propose(integrator& mc, config *new_state,
+                            int obj_number) = 0;    ///< Move an object.
+    virtual void    tally(integrator& mc, config *the_state, int obj_number,
+                          int move_kind, bool accepted) = 0;  ///< Record the outcome of a move.
+    virtual void    write_checkpoint(std::ostream& dest);   ///< Save the state in binary.
+    virtual void    read_checkpoint(std::istream& src);     ///< Restore the saved state.
+
+    /// Are the step sizes still adapted after n_step steps?
+    inline bool adapting(int n_step) const {
+        return ( freeze_step <= 0 ) || ( n_step < freeze_step );
+    }
+
+    int     freeze_step;                    ///< Steps after which adaptation stops, 0 for never.
+
+protected:
+    bool    adapt;                          ///< Set by adjust(), the step sizes change in this step.
+};
+
+class legacy_controller : public step_controller {
+public:
+    step_controller *clone() const;
+    int     type() const;
+    void    adjust(integrator& mc, config *the_state, int n_step);
+    int     propose(integrator& mc, config *new_state, int obj_number);
+    void    tally(integrator& mc, config *the_state, int obj_number,
+                  int move_kind, bool accepted);
+};
+
+class target_controller : public step_controller {
+public:
+    target_controller(double target);       ///< Constructor with the target acceptance.
+    step_controller *clone() const;
+    int     type() const;
+    void    adjust(integrator& mc, config *the_state, int n_step);
+    int     propose(integrator& mc, config *new_state, int obj_number);
+    void    tally(integrator& mc, config *the_state, int obj_number,
+                  int move_kind, bool accepted);
+    void    write_checkpoint(std::ostream& dest);
+    void    read_checkpoint(std::istream& src);
+    double  step_size(int o_type, int move_kind);   ///< The current size of a kind of move.
+
+    double  target;                         ///< The acceptance aimed for.
+
+private:
+    void    add_type(integrator& mc, config *the_state,
+                     int o_type);           ///< Make room for an object type.
+
+    std::vector<double> step[2];            ///< Translation and rotation sizes of each object type.
+    std::vector<long>   n_tried[2];         ///< Moves of each kind and type since the last adjustment.
+    std::vector<long>   n_good[2];          ///< Accepted moves among those.
+    std::vector<int>    symmetry;           ///< Rotational symmetry of each object type.
+};
+
+#endif /* STEP_CONTROLLER_H */
@@ -9,6 +9,9 @@
 #include <malloc.h>
 #include "topology.h"
 #include "common.h"
+#include "scanner.h"
+#include <cstring>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
@@ -19,6 +22,8 @@
 
 using namespace std;
 
+#define SYMMETRY_TOL    1e-3        // Largest distance between atom positions considered identical.
+
 topology::topology() {                          // An empty topology has no molecules or atoms.
     n_atom_types = 0;
     n_molecules  = 0;
@@ -38,6 +43,7 @@ topology::topology(topology* orig){		// Make a deep copy
     for( size_t i =0; i < n_molecules; i++ ){
         molecules(i).mol_name.assign(orig->molecules(i).mol_name);
         molecules(i).n_atoms = orig->molecules(i).n_atoms;
+        molecules(i).symmetry = orig->molecules(i).symmetry;
         molecules(i).the_atoms.resize(molecules(i).n_atoms);
         for(int j=0; j< molecules(i).n_atoms; j++ ){
             molecules(i).the_atoms(j) = orig->molecules(i).the_atoms(j);
@@ -46,13 +52,13 @@ topology::topology(topology* orig){		// Make a deep copy
 }
 
 topology::topology(const char *filename) {      // Read the topology from a named file.
-    ifstream ff(filename);
-    read_topology( ff );
-    ff.close();
+    scanner source( filename );
+    read_topology( source );
 }
 
 topology::topology(std::istream& source) {      // Read the topology from an open file.
-    read_topology( source );
+    scanner src( source, "topology" );
+    read_topology( src );
 }
 
 topology::topology(float size) {
@@ -77,88 +83,65 @@ bool topology::check() {			// Should also check all molecules and names!
 }
 
 /**
- * Helper function to strip blank lines and comments from an input stream.
- * This should really be declared in common.h and defined in common.cpp
- * TODO Create and organise common.cpp
- */
-bool
-my_getline(std::istream& ff, string *line){
-    while(getline(ff, *line)){		        // Read a new line
-        if(line->find('#')<line->npos)		// Remove comments
-            line->erase(line->find('#'));
-        while(line->size() && isspace(line->front())) 
-            line->erase(line->begin());
-        while(line->size() && isspace(line->back())) 
-            line->pop_back();
-        if( !line->empty() ) return true;
-    }
-    return false;
-}
-
-
-/**
- * Read a topology from a FILE
- * @param source a FILE pointer for an input stream.
+ * Read a topology.
+ * @param source a scanner positioned at the start of the topology.
  *
- * This should deal sensibly with errors and be able to ignore blank lines
- * and comments that run from # to the end of the line.
- * Various errors either from the file reading or the file structure will
- * cause a runtime_error to be thrown.
+ * Blank lines and comments that run from # to the end of the line are
+ * ignored. The name of a molecule is the whole of its line, it may be
+ * followed by a line 'symmetry <order>' declaring its order of rotational
+ * symmetry, otherwise this is found from the atom positions
+ * (find_symmetry()). Errors in the file structure cause a runtime_error to be thrown
+ * giving the line and column where the problem was found.
  */
 void
-topology::read_topology(std::istream& ff ) {
+topology::read_topology(scanner& source ) {
     size_t	i;
-    double	size;
-    std::string	line;
     std::string	name;
 
-    // Check if the file exists
-    if(ff.fail())                     throw runtime_error("Could not open topology file\n");
-    if(!my_getline(ff, &line))        throw runtime_error("Found no content in the topology file\n");
-    istringstream iss(line);
-    if (!(iss >> n_atom_types))       throw runtime_error("First line of the topology file should have number of atom types, exiting ...\n");
+    if(!source.next_line())           source.error("found no content in the topology file");
+    n_atom_types = source.get_int("number of atom types");
     atom_names.resize(n_atom_types);
     atom_sizes.resize(n_atom_types);
     for( i = 0; i < n_atom_types; i++ ){
-        if(!my_getline(ff, &line))    throw runtime_error("Error reading atom list unexpected end..\n");
-        iss.clear();
-        iss.str(line);
-        if( !(iss >> name >> size ))  throw runtime_error("Error reading atom list unexpected line...\n");
-        atom_sizes[i] = size;
-	atom_names(i).assign(name);
+        if(!source.next_line())       source.error("file ended in the atom list");
+	atom_names(i).assign(source.get_word("atom name"));
+        atom_sizes[i] = source.get_double("atom size");
     }
 
-    if(!my_getline(ff, &line))        throw runtime_error("File ended before molecule descriptions., exiting... \n");
-    iss.clear();
-    iss.str(line);
-    if (!(iss >> n_molecules))        throw runtime_error("Failed to read number of molecules, exiting ...\n");
+    if(!source.next_line())           source.error("file ended before the molecule descriptions");
+    n_molecules = source.get_int("number of molecules");
     molecules.resize(n_molecules);
     for( i = 0; i < n_molecules; i++ ){
-        if(!my_getline(ff, &line))    throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-        iss.clear();
-        iss.str(line);
-        if (!(iss >> name))           throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-        molecules[i].mol_name.assign(name);
-        if(!my_getline(ff, &line))    throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-        iss.clear();
-        iss.str(line);
-        if (!(iss >> molecules[i].n_atoms)) 
-                                      throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-        assert( molecules[i].n_atoms > 0 );
+        if(!source.next_line())       source.error("file ended in the molecule descriptions");
+        molecules[i].mol_name.assign(source.get_rest("molecule name"));
+        int     declared = -1;          // Symmetry to find from the atoms
+        if(!source.next_line())       source.error("file ended in the molecule descriptions");
+        if(!source.try_int(&molecules[i].n_atoms)){
+            if( source.get_word("number of atoms") != "symmetry" )
+                                      source.error("expected the number of atoms or a symmetry line");
+            declared = source.get_int("molecule symmetry");
+            if( declared < 0 )        source.error("negative molecule symmetry");
+            if(!source.next_line())   source.error("file ended in the molecule descriptions");
+            molecules[i].n_atoms = source.get_int("number of atoms");
+        }
+        if( molecules[i].n_atoms <= 0 )
+                                      source.error("a molecule needs at least one atom");
         molecules[i].the_atoms.resize(molecules[i].n_atoms);
         for(int j=0; j< molecules[i].n_atoms; j++ ){
-            if(!my_getline(ff, &line ))
-                                      throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-            iss.clear();
-            iss.str(line);
-            if (!(iss >> molecules[i].the_atoms[j].type
-                      >> molecules[i].the_atoms[j].x_pos
-                      >> molecules[i].the_atoms[j].y_pos
-                      >> molecules[i].the_atoms[j].color ))
-                                      throw runtime_error("File ended unexpectedly in molecule descriptions., exiting... \n");
-            if( molecules[i].the_atoms[j].type >= (int) n_atom_types )
-                                      throw runtime_error("Undefined atom type in molecule\n");
+            atom&   the_atom = molecules[i].the_atoms[j];
+
+            if(!source.next_line())   source.error("file ended in the molecule descriptions");
+            the_atom.type  = source.get_int("atom type");
+            if(( the_atom.type < 0 ) || ( the_atom.type >= (int) n_atom_types ))
+                                      source.error("undefined atom type in molecule");
+            the_atom.x_pos = source.get_double("atom x position");
+            the_atom.y_pos = source.get_double("atom y position");
+            name = source.get_word("atom color");
+            if( name.size() >= MAX_COLOR_LEN )
+                                      source.error("atom color name is too long");
+            strcpy( the_atom.color, name.c_str() );
         }
+        molecules[i].symmetry = ( declared >= 0 ) ? declared : find_symmetry( i );
     }
 }
 
@@ -179,7 +162,8 @@ topology::write(ostream& dest){
     }
     dest << n_molecules << "\n";
     for( i = 0; i < n_molecules; i++ ){
-        dest << molecules(i).mol_name.c_str() << "\n" 
+        dest << molecules(i).mol_name.c_str() << "\n"
+             << "symmetry\t" << molecules(i).symmetry << "\n"
              << std::to_string(molecules(i).n_atoms) << "\n";
         for(int j = 0; j < molecules(i).n_atoms; j++)
             dest << molecules(i).the_atoms(j).type << "\t" 
@@ -215,6 +199,120 @@ topology::add_molecule( float r ){
     molecules.resize( n_molecules );
     molecules[i].rename( "Hard disk" );
     molecules[i].add_atom( an_atom );
+    molecules[i].symmetry = 0;
     delete an_atom;
 }
 
+
+/**
+ * Radius of the smallest disc centred on the molecule origin that
+ * contains all the atoms of the molecule. Two molecules can only touch if
+ * their centres are closer than the sum of their bounding radii.
+ * @param mol the molecule type.
+ */
+double
+topology::bounding_radius( int mol ){
+    double  result = 0.0;
+
+    for(int j = 0; j < molecules(mol).n_atoms; j++ ){
+        atom&   an_atom = molecules(mol).the_atoms(j);
+        double  reach = sqrt( an_atom.x_pos * an_atom.x_pos + an_atom.y_pos * an_atom.y_pos )
+                        + atom_sizes( an_atom.type );
+        if( reach > result ) result = reach;
+    }
+    return result;
+}
+
+/**
+ * Radius of the largest disc centred on the molecule origin that lies
+ * entirely inside one of the atoms. Two molecules always clash if their
+ * centres are closer than the sum of their core radii. The result is zero
+ * if no atom covers the origin.
+ * @param mol the molecule type.
+ */
+double
+topology::core_radius( int mol ){
+    double  result = 0.0;
+
+    for(int j = 0; j < molecules(mol).n_atoms; j++ ){
+        atom&   an_atom = molecules(mol).the_atoms(j);
+        double  inside = atom_sizes( an_atom.type )
+                         - sqrt( an_atom.x_pos * an_atom.x_pos + an_atom.y_pos * an_atom.y_pos );
+        if( inside > result ) result = inside;
+    }
+    return result;
+}
+
+double
+topology::max_bounding_radius(){
+    double  result = 0.0;
+
+    for( size_t i = 0; i < n_molecules; i++ )
+        result = std::max( result, bounding_radius( i ));
+    return result;
+}
+
+/**
+ * Single atom molecules centred on the molecule origin, like the default
+ * hard discs, allow pair calculations that need neither the orientation
+ * nor the atom offsets.
+ */
+bool
+topology::is_simple(){
+    for( size_t i = 0; i < n_molecules; i++ ){
+        if( molecules(i).n_atoms != 1 ) return false;
+        atom&   an_atom = molecules(i).the_atoms(0);
+        if(( an_atom.x_pos != 0.0 ) || ( an_atom.y_pos != 0.0 )) return false;
+    }
+    return( n_molecules > 0 );
+}
+
+/**
+ * The order of rotational symmetry of a molecule, as declared in the
+ * topology file or found by find_symmetry().
+ * @param mol the molecule type.
+ * @return 0 for a molecule unchanged by any rotation, otherwise the number
+ *         of rotations by 360/symmetry degrees that leave it unchanged.
+ */
+int
+topology::symmetry( int mol ){
+    return molecules(mol).symmetry;
+}
+
+/**
+ * Find the order of rotational symmetry of a molecule from the positions
+ * and types of its atoms. A molecule with all its atoms at the origin is
+ * circular (0). Otherwise the result is the largest n for which a rotation
+ * by 360/n degrees takes every atom onto an atom of the same type, within
+ * SYMMETRY_TOL. The atoms away from the origin limit n.
+ * @param mol the molecule type.
+ */
+int
+topology::find_symmetry( int mol ){
+    molecule&   the_mol = molecules(mol);
+    int         n_off = 0;              // Atoms away from the origin
+
+    for(int j = 0; j < the_mol.n_atoms; j++ ){
+        atom&   an_atom = the_mol.the_atoms(j);
+        if( hypot( an_atom.x_pos, an_atom.y_pos ) > SYMMETRY_TOL ) n_off++;
+    }
+    if( n_off == 0 ) return 0;
+    for(int n = n_off; n > 1; n-- ){
+        double  c = cos( M_2PI / n );
+        double  s = sin( M_2PI / n );
+        bool    same = true;
+        for(int j = 0; same && ( j < the_mol.n_atoms ); j++ ){
+            atom&   an_atom = the_mol.the_atoms(j);
+            double  x = c * an_atom.x_pos - s * an_atom.y_pos;
+            double  y = s * an_atom.x_pos + c * an_atom.y_pos;
+            same = false;
+            for(int k = 0; !same && ( k < the_mol.n_atoms ); k++ ){
+                atom&   other = the_mol.the_atoms(k);
+                same = ( other.type == an_atom.type ) &&
+                       ( hypot( other.x_pos - x, other.y_pos - y ) <= SYMMETRY_TOL );
+            }
+        }
+        if( same ) return n;
+    }
+    return 1;
+}
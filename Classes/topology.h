@@ -14,6 +14,7 @@
 #define TOPOLOGY_H
 
 #include "molecule.h"
+#include "scanner.h"
 #include <string>
 #include <vector>
 #include <boost/numeric/ublas/vector.hpp>
@@ -47,6 +48,12 @@ public:
     int     write(std::ostream& dest );  ///< Write the topology to c++ ofstream.
 
     void    add_molecule( float r );     ///< Add a new molecule type to the topology circle radius r.
+    double  bounding_radius( int mol ); ///< Radius of the disc around the molecule centre enclosing all its atoms.
+    double  core_radius( int mol );     ///< Radius of the disc around the molecule centre inside one of its atoms.
+    double  max_bounding_radius();      ///< Largest bounding radius of all the molecules.
+    bool    is_simple();                ///< True if every molecule is a single atom at its centre.
+    int     symmetry( int mol );        ///< Order of rotational symmetry of a molecule, 0 if circular.
+    int     find_symmetry( int mol );   ///< Work out the rotational symmetry from the atom positions.
 
     size_t  n_atom_types;                ///< Total number of different atom types.
     vector<std::string>    atom_names;   ///< Labels for the different types of atoms.
@@ -54,7 +61,7 @@ public:
     size_t  n_molecules;                 ///< Number of different molecules in topology.
     vector<molecule>       molecules;    ///< List/Vector of the different molecule types.
 private:
-    void    read_topology(std::istream& source); ///< Helper routine for reading a topology file.
+    void    read_topology(scanner& source);   ///< Helper routine for reading a topology file.
     bool    check();                     ///< Helper routine verify that the topology is good.
 
 /*  bool    check_topology();            ///< Verify all is well with the topology.
@@ -20,8 +20,10 @@
  *
  * To use the program the command line is:
  *
- *      NVT [-vpq][-t topology][-f forcefield][-o final_config][-c initial_config] [-l log_file] 
- *          [-n frame_freq] [-s traj_file] [-r r_list] n_steps print_frequency beta pressure
+ *      NVT [-vpqPwT][-t topology][-f forcefield][-o final_config][-c initial_config] [-l log_file] 
+ *          [-n frame_freq] [-s traj_file] [-k checkpoint] [-e checkpoint_freq] [-j stats_file]
+ *          [-m tally_file] [-d check_freq] [-E tolerance] [-a acceptance] [-F freeze_step] [-O sort_freq]
+ *          [-R restart] [-S seed] n_steps print_frequency beta pressure
  *
  * Where the various parameters are:
  *      n_steps         The number of simulation steps to make.
@@ -50,8 +52,58 @@
  *
  *      -s traj_file	Optional file for logging the trajectory a gzipped format.
  *
- *	-r r_list	The size of pre-filter for the distance between object. That 
- *			should be equal or less than the higher diameter of biggest object
+ *	-r r_list	Ignored, kept so that old scripts still run. Objects too far
+ *			apart to interact are skipped using their bounding radii.
+ *
+ *      -k checkpoint   Optional file to which a binary checkpoint is written
+ *                      periodically, and at the end of the run.
+ *
+ *      -e checkpoint_freq The number of steps between checkpoints (default
+ *                      the print frequency).
+ *
+ *      -R restart      Continue the run saved in the checkpoint file restart,
+ *                      replaces the initial configuration. n_steps is the total
+ *                      including the steps made before the checkpoint.
+ *
+ *      -S seed         Seed for the random number generator, to make a run
+ *                      reproducible.
+ *
+ *      -P              Time the phases of the integration and report them,
+ *                      with counts of the pairs evaluated, in the log at each
+ *                      print and at the end.
+ *
+ *      -j stats_file   Also write the state of the run at each print to this
+ *                      file, as comma separated values if the name ends in
+ *                      .csv or JSON lines otherwise.
+ *
+ *      -m tally_file   Write the move tallies and step size of every object at
+ *                      each print to this binary file, see NVT.md for the
+ *                      format. The log only summarises the acceptance of the
+ *                      objects.
+ *
+ *      -d check_freq   Every check_freq steps compare the energies kept up to
+ *                      date during the integration with a calculation from
+ *                      scratch, and stop with a description of the objects
+ *                      concerned if they differ.
+ *
+ *      -E tolerance    The largest relative difference accepted by these
+ *                      checks (default 1e-9).
+ *
+ *      -a acceptance   Use uniform moves whose size is adapted, for each type
+ *                      of object and kind of move, to reach this acceptance
+ *                      (target_controller) rather than the original moves.
+ *
+ *      -F freeze_step  Stop adapting the step sizes after this many steps, so
+ *                      that the rest of the run respects detailed balance.
+ *
+ *      -w              Move the objects in turn, in sweeps along a space
+ *                      filling curve, rather than choosing them at random.
+ *
+ *      -O sort_freq    Every sort_freq steps reorder the objects in memory along
+ *                      a space filling curve, output keeps the original order.
+ *
+ *      -T              Append every move and its outcome to the debugging trace
+ *                      NEW_algorithme_movement.txt in the working directory.
  *
  * \todo log file       Use a dedicated function for writing data so it is easier
  *                      to parse after and control the structure.  Perhaps in
@@ -60,10 +112,18 @@
  */
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <unistd.h>
 #include "../Classes/integrator.h"
+#include "../Classes/checkpoint.h"
 #include "../Classes/common.h"
+#include "../Classes/stats_stream.h"
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
 
 #include "../Libraries/gzstream.h"
 
@@ -77,6 +137,10 @@ using boost::format;
 using namespace std;
 
 
+#define TALLY_MAGIC     "HDTALY"        // Start of a tally file
+#define TALLY_VERSION   1
+#define N_BINS          10              // Bins of the acceptance histogram
+
 #define fatal_error(format, value) {\
                     fprintf(stderr, format, value ); \
                     exit(EXIT_FAILURE); \
@@ -85,11 +149,117 @@ using namespace std;
 
 void 
 usage(int val){
-    std::cerr << "NVT [-vpq][-t topology][-f forcefield][-o final_config][-c initial_config]"
-        << "[-l log_file] [-n save-frequency] [-s save_file] [-r r_list] n_steps print_frequency beta pressure \n";
+    std::cerr << "NVT [-vpqPwT][-t topology][-f forcefield][-o final_config][-c initial_config]"
+        << "[-l log_file] [-n save-frequency] [-s save_file] [-k checkpoint]"
+        << "[-e checkpoint_freq] [-j stats_file] [-m tally_file] [-d check_freq] [-E tolerance] [-a acceptance] [-F freeze_step] [-O sort_freq] [-R restart] [-S seed] n_steps print_frequency beta pressure \n";
     exit(val);
 }
 
+/*
+ * Write a checkpoint of the run after 'step' steps. The data goes to a
+ * temporary file that is renamed over the destination once complete, so
+ * that a job killed while writing still leaves the previous checkpoint.
+ */
+bool
+write_checkpoint(const string& name, int step, integrator *the_integrator, config *the_state){
+    string          tmp_name = name + ".tmp";
+    std::ofstream   dest(tmp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+    std::ostringstream rng_state;
+
+    if( !dest.good() ) return false;
+    dest.write( CKPT_MAGIC, strlen(CKPT_MAGIC) );
+    ckpt_put(dest, (int)CKPT_VERSION);
+    ckpt_put(dest, step);
+    the_integrator->write_checkpoint(dest);
+    the_state->write_checkpoint(dest);
+    rnd_save(rng_state);
+    ckpt_put_string(dest, rng_state.str());
+    dest.close();
+    if( dest.fail() ) return false;
+    return( rename(tmp_name.c_str(), name.c_str()) == 0 );
+}
+
+/*
+ * Restore the run saved by write_checkpoint(), returns the step count.
+ * Throws a runtime_error if the file is not a valid checkpoint.
+ */
+int
+read_checkpoint(const string& name, integrator *the_integrator, config *the_state){
+    std::ifstream   src(name, std::ios::in | std::ios::binary);
+    char            magic[sizeof(CKPT_MAGIC)];
+    int             version, step;
+    string          rng_state;
+
+    if( src.fail() ) throw runtime_error("Could not open checkpoint file\n");
+    src.read( magic, strlen(CKPT_MAGIC) );
+    magic[strlen(CKPT_MAGIC)] = '\0';
+    if( !src.good() || strcmp(magic, CKPT_MAGIC) )
+        throw runtime_error("Not a checkpoint file\n");
+    ckpt_get(src, version);
+    if( version != CKPT_VERSION )
+        throw runtime_error("Unsupported checkpoint version\n");
+    ckpt_get(src, step);
+    the_integrator->read_checkpoint(src);
+    the_state->read_checkpoint(src);
+    ckpt_get_string(src, rng_state);
+    std::istringstream rng_stream(rng_state);
+    rnd_load(rng_stream);
+    return step;
+}
+
+/*
+ * The size of a file in bytes, 0 if it does not exist.
+ */
+long
+file_size(const string& name){
+    struct stat info;
+    if( stat(name.c_str(), &info) != 0 ) return 0;
+    return (long)info.st_size;
+}
+
+/*
+ * The memory used by the programme (the resident set) in kB, 0 if unknown.
+ */
+long
+resident_kb(){
+    std::ifstream   statm("/proc/self/statm");
+    long            size = 0, resident = 0;
+
+    if( !( statm >> size >> resident )) return 0;
+    return resident * ( sysconf(_SC_PAGESIZE) / 1024 );
+}
+
+/*
+ * Summarise the acceptance ratio, n_good/(n_good+n_bad), of the objects
+ * that have been moved with percentiles and a histogram.
+ */
+void
+log_acceptance(std::ostream& dest, config *the_state){
+    std::vector<double> ratio;
+    std::vector<int>    histogram(N_BINS, 0);
+    int                 n_idle = 0;
+
+    for(int k = 0; k < the_state->n_objects(); k++){
+        int moves = the_state->objects_ngood(k) + the_state->objects_nbad(k);
+        if( moves == 0 ){
+            n_idle++;
+            continue;
+        }
+        ratio.push_back( (double)the_state->objects_ngood(k) / moves );
+        histogram[ simple_min( (int)( ratio.back() * N_BINS ), N_BINS - 1 ) ]++;
+    }
+    dest << format("Object acceptance, %d objects moved, %d not moved\n")
+        % ratio.size() % n_idle;
+    if( ratio.empty() ) return;
+    std::sort( ratio.begin(), ratio.end() );
+    dest << "Percentiles";
+    for( int p : { 0, 10, 25, 50, 75, 90, 100 } )
+        dest << format(" %d%%: %.3g") % p % ratio[ ( p * ( ratio.size() - 1 ) + 50 ) / 100 ];
+    dest << "\nHistogram from 0 to 1 by " << 1.0 / N_BINS << ":";
+    for( int count : histogram ) dest << " " << count;
+    dest << "\n";
+}
+
 /*
  *
  */
@@ -102,6 +272,10 @@ int main(int argc, char** argv) {
     string       log_name;
     string       topo_name;
     string	 traj_name;
+    string	 ckpt_name;
+    string	 restart_name;
+    string	 stats_name;
+    string	 tally_name;
 
     // Objects in headers
     config      *current_state = NULL;
@@ -118,27 +292,37 @@ int main(int argc, char** argv) {
     bool	verbose  = false;
     bool	periodic = false;
     bool	rot_flag = false;    
+    bool	profile  = false;	// Report timers and counters
+    bool	sweep    = false;	// Move the objects in sweeps
 
     int         it_max = 0;
     int         n_print = 0;
     int		traj_freq = 0;		// Frequency for saving frames to trajectory (0=never)
+    int		ckpt_freq = 0;		// Frequency for writing checkpoints (0=print frequency)
+    int		i_start = 0;		// Step count at the start (non zero for a restart)
+    int		check_freq = 0;		// Frequency of the energy checks (0=never)
+    double	check_tolerance = 1e-9;	// Relative error accepted by the checks
+    double	target = 0.0;		// Acceptance aimed for (0=original moves)
+    int		freeze_step = 0;	// Step after which moves are not adapted (0=never)
+    int		sort_freq = 0;		// Frequency of reordering the objects (0=never)
+    long	seed = (long)&argv[0];	// Seed for the random number generator
     double      beta = 1.0;
     double      dl_max = 1.0;
     double      pressure = 1.0;
-    float	 r_list= 0.00; //r_list is a pre-filter for the distance between object. That should be equal or less than the higher diameter of biggest object. r_list default is 0.00.  
 
     // Initialization
 
-    srand((long)&argv[0]);
-
     // Handle command line
-    while( ( c = getopt (argc, argv, "vpc:f:t:o:l:n:s:r:") ) != -1 )
+    while( ( c = getopt (argc, argv, "vpqPwTc:f:t:o:l:n:s:r:k:e:j:m:d:E:a:F:O:R:S:") ) != -1 )
     {
         switch(c)
         {
             case 'v': verbose  = true; break;
             case 'p': periodic = true; break;
             case 'q': rot_flag = true; break;
+            case 'P': profile  = true; break;
+            case 'w': sweep    = true; break;
+            case 'T': config::trace_moves = true; break;
             case 'c': if (optarg) in_name = optarg;
                 break;
             case 'l': if (optarg) log_name = optarg;
@@ -153,16 +337,39 @@ int main(int argc, char** argv) {
                 break;
             case 's': if (optarg) traj_name = optarg;
                 break;
-            case 'r': if (optarg){
-                          r_list = std::atof(optarg);
-                      }
-            		
+            case 'r': std::cerr << "The -r option is no longer needed and is ignored.\n";
+                break;
+            case 'k': if (optarg) ckpt_name = optarg;
+                break;
+            case 'e': if (optarg) ckpt_freq = std::atoi(optarg);
+                break;
+            case 'j': if (optarg) stats_name = optarg;
+                break;
+            case 'm': if (optarg) tally_name = optarg;
+                break;
+            case 'd': if (optarg) check_freq = std::atoi(optarg);
+                break;
+            case 'E': if (optarg) check_tolerance = std::atof(optarg);
+                break;
+            case 'a': if (optarg) target = std::atof(optarg);
+                break;
+            case 'F': if (optarg) freeze_step = std::atoi(optarg);
+                break;
+            case 'O': if (optarg) sort_freq = std::atoi(optarg);
+                break;
+            case 'R': if (optarg) restart_name = optarg;
+                break;
+            case 'S': if (optarg) seed = std::atol(optarg);
                 break;
             case 'h': usage(EXIT_SUCCESS);
             case '?':				// Something wrong.
                 if (optopt == 'c' or optopt == 'f' or optopt == 't' or 
                     optopt == 'o' or optopt == 'l' or optopt == 'n' or
-                    optopt == 's' or optopt == 'r' ){
+                    optopt == 's' or optopt == 'r' or optopt == 'k' or
+                    optopt == 'e' or optopt == 'j' or optopt == 'm' or
+                    optopt == 'd' or optopt == 'E' or optopt == 'a' or
+                    optopt == 'F' or optopt == 'O' or optopt == 'R' or
+                    optopt == 'S' ){
                     std::cerr << "The -" << optopt << " option is missing a parameter!\n";
                 } else {
                     std::cerr << "Unknown option " << optopt << "!\n";
@@ -172,6 +379,8 @@ int main(int argc, char** argv) {
         }
     }
 
+    rnd_seed(seed);
+
     std::ofstream log_file;
     #define logger ((log_file.is_open())? log_file : std::cout )
     if( log_name.length() > 0 ){
@@ -191,12 +400,6 @@ int main(int argc, char** argv) {
     beta     = std::atof( argv[ optind++ ] );
     pressure = std::atof( argv[ optind++ ] );
     
-    // prompt error message if radius is under 0.00
-    if(r_list < 0 ){
-        std::cerr << "Negative , r_list distance invalid.\n";
-	usage(EXIT_FAILURE);
-    }
-    
     if(it_max <= 0 ){
         std::cerr << "Nothing to do, number of steps invalid.\n";
 	usage(EXIT_FAILURE);
@@ -213,10 +416,34 @@ int main(int argc, char** argv) {
         std::cerr << "Negative pressure invalid.\n";
 	usage(EXIT_FAILURE);
     }
+    if( ckpt_freq < 0 ){
+        std::cerr << "Negative checkpoint frequency invalid.\n";
+	usage(EXIT_FAILURE);
+    }
+    if(( check_freq < 0 ) || ( check_tolerance <= 0 )){
+        std::cerr << "Negative energy check frequency or tolerance invalid.\n";
+	usage(EXIT_FAILURE);
+    }
+    if( sort_freq < 0 ){
+        std::cerr << "Negative sort frequency invalid.\n";
+	usage(EXIT_FAILURE);
+    }
+    if( sort_freq == 0 ) sort_freq = it_max + 1;		// Never reorder
+    if(( target < 0 ) || ( target >= 1 ) || ( freeze_step < 0 )){
+        std::cerr << "Target acceptance outside 0..1 or negative freeze step invalid.\n";
+	usage(EXIT_FAILURE);
+    }
+    if( ckpt_name.length() == 0 ){
+        ckpt_freq = it_max + 1;					// Don't want checkpoints
+    } else if( ckpt_freq == 0 ){
+        ckpt_freq = n_print;
+    }
 
     if( verbose ) logger << "Reading configuration.\n";
     try{
-        if( in_name.length() > 0 ){
+        if( restart_name.length() > 0 ){
+            current_state = new config();		// Filled from the checkpoint below
+        } else if( in_name.length() > 0 ){
             current_state = new config(in_name);
         } else {
             current_state = new config(std::cin);
@@ -305,10 +532,59 @@ int main(int argc, char** argv) {
         traj_freq = it_max + 1;					// Don't want a trajectory
     }
 
+    // Setup to write the statistics
+    stats_stream	*stats_out = NULL;
+
+    if( stats_name.length() > 0 ){
+        try{
+            stats_out = new stats_stream(stats_name);
+        }
+        catch(exception &e){
+            std::cerr << "Error " << e.what();
+            delete current_state;
+            delete the_forces;
+            delete a_topology;
+            exit( EXIT_FAILURE );
+        }
+        if( verbose ) logger << stats_name << " opened for the statistics.\n";
+    }
+
+    // Setup to write the object tallies
+    std::ofstream	tally_file;
+
+    if( tally_name.length() > 0 ){
+        tally_file.open( tally_name, std::ios::out | std::ios::binary | std::ios::trunc );
+        if( ! tally_file.good() ){
+            std::cerr << "Error while opening file " << tally_name << " for the tallies.\n";
+            if( stats_out ) delete stats_out;
+            delete current_state;
+            delete the_forces;
+            delete a_topology;
+            exit( EXIT_FAILURE );
+        }
+        tally_file.write( TALLY_MAGIC, strlen(TALLY_MAGIC) );
+        ckpt_put(tally_file, (int)TALLY_VERSION);
+        if( verbose ) logger << tally_name << " opened for the object tallies.\n";
+    }
+
     // Add the topology to the configuration.
     current_state->add_topology(a_topology);
 
-    if( current_state->is_rectangle ){
+    if( restart_name.length() > 0 ){			// Restore the saved run
+        the_integrator = new integrator(the_forces);
+        if( target > 0 ) the_integrator->set_controller( new target_controller(target) );
+        try{
+            i_start = read_checkpoint(restart_name, the_integrator, current_state);
+        }
+        catch(exception &e){
+            std::cerr << "Error reading checkpoint " << restart_name << ": " << e.what();
+            delete the_integrator;
+            delete current_state;
+            delete the_forces;
+            exit( EXIT_FAILURE );
+        }
+        logger << "Restarting from " << restart_name << " after " << i_start << " steps\n";
+    } else if( current_state->is_rectangle ){
         current_state->is_periodic = periodic;
     } else if( periodic ){					/// TODO convert parallelogram to rectangle
         if( current_state->poly->is_parallelogram() ){
@@ -321,72 +597,85 @@ int main(int argc, char** argv) {
         }
     }
     
-    U1 = current_state->energy(the_forces, r_list);
+    U1 = current_state->energy(the_forces);
     V1 = current_state->area();
     N1 = current_state->n_objects();
 
     // Print report of state, both in terminal and log
-    logger << "After" << std::to_string( 0 ) << " steps...\n";
+    logger << "After" << std::to_string( i_start ) << " steps...\n";
     logger << format("N objects = %9d Pressure = %9g   Beta = %9g\n") % N1 % pressure % beta;
     logger << format("Area      = %9g  Density = %9g Energy = %9g\n\n") % V1 % (N1/V1) % U1;
 
-    //Calculate the global dl_max
-    dl_max = simple_min(current_state->width(), current_state->height())/2.0;
+    if( restart_name.length() == 0 ){			// A restart has its own step sizes
+        //Calculate the global dl_max
+        dl_max = simple_min(current_state->width(), current_state->height())/2.0;
     
-    //Set dl_max of each object as global dl_max
-    for (int obj_number = 0; obj_number < N1; obj_number++){
-        current_state->set_obj_dl_max(obj_number, dl_max);
-    }
+        //Set dl_max of each object as global dl_max (truncated as by set_obj_dl_max)
+        current_state->reset_obj_dl_max((int)dl_max);
 
-    // Jiggle everything to remove bad contacts from save/load
-    i = 0;          // Counter for number of shifts.
-    if((U1 > the_forces->big_energy) && verbose ){
-        logger << "Jiggle is necessary.\n";
-    } else {
-        logger << "No jiggle is necessary.\n";
-    }
+        // Jiggle everything to remove bad contacts from save/load
+        i = 0;          // Counter for number of shifts.
+        if((U1 > the_forces->big_energy) && verbose ){
+            logger << "Jiggle is necessary.\n";
+        } else {
+            logger << "No jiggle is necessary.\n";
+        }
     
-    i = 0;
+        i = 0;
 
-    while(U1 > the_forces->big_energy){
-        if( the_integrator ) delete the_integrator;
-        if( i > 2000*N1 ){
-            delete the_forces;
-            delete current_state;
-            fatal_error("Unable to adjust initial configuration in %d steps", i );
+        while(U1 > the_forces->big_energy){
+            if( the_integrator ) delete the_integrator;
+            if( i > 2000*N1 ){
+                delete the_forces;
+                delete current_state;
+                fatal_error("Unable to adjust initial configuration in %d steps", i );
+            }
+            the_integrator = new integrator(the_forces);
+            the_integrator->dl_max = dl_max;
+            the_integrator->rot_flag = rot_flag;  // Adding -q option for rotation move
+            state_h = &current_state;
+            the_integrator->run(state_h, beta, pressure, 2*N1);
+            current_state = *state_h;
+            dl_max = the_integrator->dl_max;
+            i += 2*N1;
+
+            U1 = current_state->energy(the_forces);
+            if( verbose ){
+                logger << "after" << std::to_string( i ) << " steps\n";
+                logger << format("N objects = %9d Pressure = %9g   Beta = %9g\n") % N1 % pressure % beta;
+                logger << format("Area      = %9g  Density = %9g Energy = %9g\n\n") % V1 % (N1/V1) % U1;
+            }
         }
-        the_integrator = new integrator(the_forces);
-        the_integrator->dl_max = dl_max;
-        the_integrator->rot_flag = rot_flag;  // Adding -q option for rotation move
-        state_h = &current_state;
-        the_integrator->run(state_h, beta, pressure, 2*N1, r_list);
-        current_state = *state_h;
-        dl_max = the_integrator->dl_max;
-        i += 2*N1;
 
-        U1 = current_state->energy(the_forces, r_list);
-        if( verbose ){
-            logger << "after" << std::to_string( i ) << " steps\n";
+        if( the_integrator ){
+            delete the_integrator;
+            i = 0;
+            logger << "After initial adjustments:\n";
             logger << format("N objects = %9d Pressure = %9g   Beta = %9g\n") % N1 % pressure % beta;
             logger << format("Area      = %9g  Density = %9g Energy = %9g\n\n") % V1 % (N1/V1) % U1;
         }
-    }
 
-    if( the_integrator ){
-        delete the_integrator;
-        i = 0;
-        logger << "After initial adjustments:\n";
-        logger << format("N objects = %9d Pressure = %9g   Beta = %9g\n") % N1 % pressure % beta;
-        logger << format("Area      = %9g  Density = %9g Energy = %9g\n\n") % V1 % (N1/V1) % U1;
+        the_integrator = new integrator(the_forces);
+        the_integrator->dl_max = dl_max;
+        the_integrator->initial_dl_max = dl_max;
+        the_integrator->rot_flag = rot_flag;
+        the_integrator->sweep    = sweep;
+        if( target > 0 ) the_integrator->set_controller( new target_controller(target) );
     }
+    the_integrator->controller->freeze_step = freeze_step;
+    the_integrator->check_freq      = check_freq;
+    the_integrator->check_tolerance = check_tolerance;
 
     // Start NVT montecarlo loop
     // Calculate next step size...
-    step = simple_min(n_print,it_max);
-    step = simple_min(step, traj_freq);
-    the_integrator = new integrator(the_forces);
-    the_integrator->dl_max = dl_max;
-    the_integrator->initial_dl_max = dl_max;
+    if( i_start == 0 ){
+        step = simple_min(n_print,it_max);
+    } else {
+        step = simple_min(it_max-i_start+1,(n_print - (i_start%n_print)));
+    }
+    step = simple_min(step,(traj_freq - (i_start%traj_freq)));
+    step = simple_min(step,(ckpt_freq - (i_start%ckpt_freq)));
+    step = simple_min(step,(sort_freq - (i_start%sort_freq)));
 
     if( verbose ){
         logger << "With" << (current_state->is_periodic?" ":"out ") << "periodic boundary conditions.\n";
@@ -394,17 +683,36 @@ int main(int argc, char** argv) {
         logger << "Starting iteration loop\n";
     }
 
-    for(i=0;i<it_max;){
+    config::stats.reset();				// Only count the integration
+    config::stats.enabled = profile;
+    perf_stats	last_stats = config::stats;		// At the last report
+    std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
+    long	io_bytes = 0;				// Trajectory and checkpoints written
+
+    for(i=i_start;i<it_max;){
 
         state_h = &current_state;
-        the_integrator->run(state_h, beta, pressure, step, r_list);
+        try{
+            the_integrator->run(state_h, beta, pressure, step);
+        }
+        catch(exception &e){				// A failed energy check
+            logger << e.what();
+            std::cerr << e.what();
+            exit( EXIT_FAILURE );
+        }
         current_state = *state_h;
 
-        U1 = current_state->energy(the_forces, r_list);
+        U1 = current_state->energy(the_forces);
         V1 = current_state->area();
         N1 = current_state->n_objects();
 
         i += step;
+        if( i%sort_freq == 0 ){				// Is it time to reorder the objects
+            the_integrator->sort_objects( current_state );
+            config::stats.charge(perf_stats::MOVE);
+            if( verbose ) logger << "Objects reordered after " << i << " steps\n";
+        }
+        config::stats.mark();
 
         if( i%n_print == 0 ){				// Is it time to print to the log file
             logger << format("After %d steps N = %d, P = %g, beta = %g\n") 
@@ -415,25 +723,76 @@ int main(int argc, char** argv) {
                 % (the_integrator->n_good)
                 % (the_integrator->n_good + the_integrator->n_bad)
                 % (the_integrator->dl_max);
-            // just to see the parameters of each object (not usefull expect during analysis)
-            for (int obj_number = 0; obj_number < N1; obj_number++){
-                logger << format("obj_number = %d, n_good = %d, n_bad = %d, n rotation = %d, n translation = %d\n") 
-                    % (obj_number)
-                    % (current_state->objects_ngood(obj_number))
-                    % (current_state->objects_nbad(obj_number))
-                    % (current_state->objects_nrot(obj_number))
-                    % (current_state->objects_ntranslation(obj_number));
+            log_acceptance( logger, current_state );
+            logger << "\n";
+            if( tally_file.is_open() ){		// The tallies of each object
+                long start = tally_file.tellp();
+                ckpt_put(tally_file, i);
+                current_state->write_tallies( tally_file );
+                tally_file.flush();
+                io_bytes += (long)tally_file.tellp() - start;
+            }
+            perf_stats	interval = config::stats.since( last_stats );
+            if( profile ){
+                logger << "Performance since the last report:\n";
+                interval.write( logger );
+                logger << "\n";
             }
+            if( stats_out ){
+                std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                double	seconds = std::chrono::duration<double>( now - last_time ).count();
+                double	moves = the_integrator->n_good + the_integrator->n_bad;
+                stats_out->add("step", i);
+                stats_out->add("n_objects", N1);
+                stats_out->add("energy", U1);
+                stats_out->add("area", V1);
+                stats_out->add("density", N1/V1);
+                stats_out->add("acceptance", the_integrator->n_good / moves);
+                stats_out->add("dl_max", the_integrator->dl_max);
+                stats_out->add("seconds", seconds);
+                stats_out->add("steps_per_s", interval.n_steps / seconds);
+                stats_out->add("pairs_per_s", interval.n_pairs / seconds);
+                stats_out->add("atom_pairs_per_s", interval.n_atom_pairs / seconds);
+                stats_out->add("memory_kb", resident_kb());
+                stats_out->add("io_bytes", io_bytes + stats_out->n_bytes()
+                        + ( log_file.is_open() ? (long)log_file.tellp() : 0 ));
+                stats_out->end_record();
+                last_time = now;
+            }
+            last_stats = config::stats;
         }
         if( i%traj_freq == 0 ){				// Is it time to print to the trajectory
-            traj_stream << "====" << i << "====\n";
-            current_state->write( traj_stream );
+            std::ostringstream frame;
+            frame << "====" << i << "====\n";
+            current_state->write( frame );
+            traj_stream << frame.str();
+            io_bytes += frame.str().size();
         }
+        if(( i%ckpt_freq == 0 ) || ( ckpt_name.length() && ( i >= it_max ))){
+            if( !write_checkpoint(ckpt_name, i, the_integrator, current_state) )
+                std::cerr << "Error while writing checkpoint " << ckpt_name << "\n";
+            else {
+                io_bytes += file_size(ckpt_name);
+                if( verbose )
+                    logger << "Checkpoint written after " << i << " steps\n";
+            }
+        }
+        
+        config::stats.charge(perf_stats::IO);
         
         step = simple_min(it_max-i+1,(n_print - (i%n_print)));
         step = simple_min(step,(traj_freq - (i%traj_freq)));
+        step = simple_min(step,(ckpt_freq - (i%ckpt_freq)));
+        step = simple_min(step,(sort_freq - (i%sort_freq)));
     }
     delete the_integrator;
+    if( stats_out ) delete stats_out;
+    if( tally_file.is_open() ) tally_file.close();
+    if( profile ){
+        logger << "Performance over the whole integration:\n";
+        config::stats.write( logger );
+        logger << "\n";
+    }
     
     if( traj_stream.good() ){				// If we are writing a trajectory
         traj_stream.close();				// Close the file
@@ -16,30 +16,325 @@
  * Input can be in the form of either a series of configurations or
  * a compressed trajectory file.
  *
+ * Frames are read in batches and the type1 objects of the batch are
+ * shared out between the worker threads (-j), each thread has its own
+ * maps that are summed at the end. The map can be limited to a maximum
+ * distance (-m) in which case the type2 objects are put in a grid of
+ * cells so only those in the neighbouring cells are examined.
+ *
  * TODO Stop error condition on normal end of file
  */
 
 #include "../Classes/config.h"
+#include "../Classes/area_cache.h"
+#include <atomic>
 #include <iostream>
+#include <thread>
+#include <vector>
 #include "../Libraries/gzstream.h"
 
+#define FRAMES_PER_THREAD	4			// Frames read per worker in each batch
+#define OBJECTS_PER_TASK	8			// Objects taken at a time by a worker
+
+/***
+ * @brief The description of the maps being accumulated.
+ */
+struct map_spec {
+	int		bin_xmax, bin_ymax;			// Number of cells
+	double	extent;						// Map covers -extent..extent
+	double	dist;						// Cell size
+	int		rotation;					// Symmetry for orientations
+	int		type1, type2;				// Object types analysed
+	bool	limited;					// Extent set by the user (-m)
+};
+
+/***
+ * @brief The maps accumulated by one thread.
+ */
+struct order_maps {
+	std::vector<double>	e_array;		// Expected number in each cell
+	std::vector<double>	n_array;		// Number found in each cell
+	std::vector<double>	dx_array;		// Sum of relative orientation sines
+	std::vector<double>	dy_array;		// and cosines
+
+	order_maps( int n_cells ) :
+		e_array(n_cells, 0.0), n_array(n_cells, 0.0),
+		dx_array(n_cells, 0.0), dy_array(n_cells, 0.0) {}
+};
+
+/***
+ * @brief A configuration with its container and the type2 objects
+ * sorted into a grid of cells at least as large as the search distance.
+ */
+struct frame {
+	config	*a_config;
+	polygon	*container;					// Boundary (closed) or minimum image box (periodic)
+	double	x0, y0;						// Origin of the grid
+	double	cx, cy;						// Size of the grid cells
+	int		nx, ny;						// Number of grid cells
+	int		n_type2;					// Number of type2 objects
+	std::vector< std::vector<int> >	cells;
+
+	frame( config *conf, const map_spec& spec );
+	~frame();
+	int	cell_x( double x ) const;
+	int	cell_y( double y ) const;
+};
+
+frame::frame( config *conf, const map_spec& spec )
+{
+	a_config = conf;
+	container = new polygon(4);
+	if( a_config->is_periodic ){		// Box centred on the object for minimum image
+		double	w = a_config->width()/2.0;
+		double	h = a_config->height()/2.0;
+		container->add_vertex( -w, -h );
+		container->add_vertex(  w, -h );
+		container->add_vertex(  w,  h );
+		container->add_vertex( -w,  h );
+		x0 = y0 = 0.0;
+	} else if( a_config->poly ){
+		delete container;
+		container = new polygon( a_config->poly );
+		x0 = container->x_min();
+		y0 = container->y_min();
+	} else {							// A closed rectangular box
+		container->add_vertex( 0.0, 0.0 );
+		container->add_vertex( a_config->x_size, 0.0 );
+		container->add_vertex( a_config->x_size, a_config->y_size );
+		container->add_vertex( 0.0, a_config->y_size );
+		x0 = y0 = 0.0;
+	}
+	container->is_inside( x0, y0 );		// Build the query grid here, the workers share it
+
+	// Cells must be larger than the furthest corner of the map.
+	double	reach = spec.extent * sqrt(2.0);
+	nx = (int) floor( a_config->width() / reach );
+	ny = (int) floor( a_config->height() / reach );
+	if(( nx < 1 ) || ( a_config->is_periodic && ( nx < 3 ))) nx = 1;
+	if(( ny < 1 ) || ( a_config->is_periodic && ( ny < 3 ))) ny = 1;
+	cx = a_config->width() / nx;
+	cy = a_config->height() / ny;
+	cells.resize( nx*ny );
+	n_type2 = 0;
+	for(int j = 0; j < a_config->n_objects(); j++ ){
+		object	*obj = a_config->get_object(j);
+		if( obj->o_type == spec.type2 ){
+			cells[ cell_x( obj->pos_x )*ny + cell_y( obj->pos_y ) ].push_back( j );
+			n_type2++;
+		}
+	}
+}
+
+frame::~frame()
+{
+	delete container;
+	delete a_config;
+}
+
+int
+frame::cell_x( double x ) const
+{
+	int	k = (int) floor(( x - x0 )/cx );
+	if( a_config->is_periodic ) return ((k % nx) + nx) % nx;
+	return ( k < 0 ) ? 0 : (( k >= nx ) ? nx-1 : k );
+}
+
+int
+frame::cell_y( double y ) const
+{
+	int	l = (int) floor(( y - y0 )/cy );
+	if( a_config->is_periodic ) return ((l % ny) + ny) % ny;
+	return ( l < 0 ) ? 0 : (( l >= ny ) ? ny-1 : l );
+}
+
 /***
  * @brief usage() Print a brief help message on program utilisation to std::cerr.
  */
 void
 usage()
 {
-    std::cerr << "Usage: 2DOrder [-v] [-z] [-o output] [-d dist] [-r rotation][-t type1] [-u type2] file1...\n" ;
+    std::cerr << "Usage: 2DOrder [-v] [-z] [-o output] [-d dist] [-r rotation][-t type1] [-u type2] [-q grid] [-m max] [-j threads] file1...\n" ;
     std::cerr << "-v verbose output to stderr,\n" 
         << "-z the input files are compressed trajectory files,\n"
         << "-o output send output to file output (default stdout),\n" 
         << "-d dist set the integration bin size to dist (default 1.0),\n" 
         << "-r rotation, symmetry to apply for organization of orientation (default 1),\n "
         << "-t type1 look at distances between objects of this type and type2 (default 0),\n" 
-        << "-u type2 look at distances between objects of this type and type1 (default 0),\n" 
+        << "-u type2 look at distances between objects of this type and type1 (default 0),\n"
+        << "-q grid reuse area normalisations for objects on the same grid point, 0 for exact (default dist/10),\n" 
+        << "-m max limit the map to dx and dy between -max and max (default whole configuration),\n"
+        << "-j threads number of threads sharing the objects (default 1),\n"
         << "file1... series of configuration or trajectory files to read, if none are given use stdin.\n" ;
 }
 
+/***
+ * @brief cell_areas() Exact fraction of the container in each cell around an object.
+ *
+ * The cells are those of the output map, squares in the frame of an object
+ * at (x0,y0) with the given orientation, covering -extent..extent. In that frame a displacement
+ * (dx,dy) has coordinates (dx sin(a) + dy cos(a), dx cos(a) - dy sin(a)),
+ * the transformation is its own inverse so the same expression gives the
+ * cell corners back in the configuration. Each cell is clipped against the
+ * container, cells outside the bounding box of the container are skipped.
+ */
+void
+cell_areas( polygon *container, double x0, double y0, double angle, double extent, double dist,
+            int bin_xmax, int bin_ymax, std::vector<double>& cells )
+{
+	double	s = sin(angle);
+	double	c = cos(angle);
+	double	wx = 2.0*extent/bin_xmax;			// Cell sizes
+	double	wy = 2.0*extent/bin_ymax;
+	double	xmin = container->x_min();
+	double	xmax = container->x_max();
+	double	ymin = container->y_min();
+	double	ymax = container->y_max();
+	double	total = container->area();
+	Point	corner[4];
+
+	cells.assign( bin_xmax*bin_ymax, 0.0 );
+	for(int k=0; k < bin_xmax; k++){
+		double u0 = k*wx - extent - dist/2.0;
+		for(int l=0; l < bin_ymax; l++){
+			double v0 = l*wy - extent - dist/2.0;
+			double cu[4] = { u0, u0+wx, u0+wx, u0 };
+			double cv[4] = { v0, v0, v0+wy, v0+wy };
+			double lo_x = xmax, hi_x = xmin, lo_y = ymax, hi_y = ymin;
+			for(int m=0; m < 4; m++){
+				corner[m].x = x0 + cu[m]*s + cv[m]*c;
+				corner[m].y = y0 + cu[m]*c - cv[m]*s;
+				lo_x = fmin( lo_x, corner[m].x );
+				hi_x = fmax( hi_x, corner[m].x );
+				lo_y = fmin( lo_y, corner[m].y );
+				hi_y = fmax( hi_y, corner[m].y );
+			}
+			if(( hi_x <= xmin ) || ( lo_x >= xmax ) || ( hi_y <= ymin ) || ( lo_y >= ymax )) continue;
+			cells[k*bin_ymax+l] = container->clip_area( corner, 4 )/total;
+		}
+	}
+}
+
+/***
+ * @brief analyse_object() Add the neighbours of a type1 object to the maps.
+ * @param fr the frame holding the object.
+ * @param i the index of the object in the configuration.
+ * @param de_uniform the expected fraction in each cell when this does
+ *        not depend on the object (periodic conditions without -m).
+ */
+void
+analyse_object( const frame& fr, int i, const map_spec& spec, const std::vector<double>& de_uniform,
+                order_maps& maps, area_cache& cache )
+{
+	config	*a_config = fr.a_config;
+	object	*obj = a_config->get_object(i);
+	const double	*de = de_uniform.data();
+	int		bin_x, bin_y;
+	int		bin_xmax = spec.bin_xmax;
+	int		bin_ymax = spec.bin_ymax;
+	double	extent = spec.extent;
+	double	s = sin(obj->orientation);
+	double	c = cos(obj->orientation);
+
+	// Find the area map if it depends on the object, in periodic conditions
+	// this is the minimum image box centred on the object.
+	if( !a_config->is_periodic || spec.limited ){
+		std::vector<double>	*cells;
+		double	x0 = a_config->is_periodic ? 0.0 : obj->pos_x;
+		double	y0 = a_config->is_periodic ? 0.0 : obj->pos_y;
+		double	angle = obj->orientation;
+		if( !cache.lookup( fr.container, &x0, &y0, &angle, &cells ))
+			cell_areas( fr.container, x0, y0, angle, extent, spec.dist, bin_xmax, bin_ymax, *cells );
+		de = cells->data();
+	}
+
+	int		k0 = fr.cell_x( obj->pos_x );
+	int		l0 = fr.cell_y( obj->pos_y );
+	int		dk = ( fr.nx > 1 ) ? 1 : 0;
+	int		dl = ( fr.ny > 1 ) ? 1 : 0;
+	for(int k = k0-dk; k <= k0+dk; k++ ){
+		for(int l = l0-dl; l <= l0+dl; l++ ){
+			int	kk = k, ll = l;
+			if( a_config->is_periodic ){
+				kk = (kk + fr.nx) % fr.nx;
+				ll = (ll + fr.ny) % fr.ny;
+			} else if(( kk < 0 ) || ( kk >= fr.nx ) || ( ll < 0 ) || ( ll >= fr.ny )) continue;
+			for( int j : fr.cells[kk*fr.ny+ll] ){
+				object	*other = a_config->get_object(j);
+
+				// Calculate bin number.
+				double dx = other->pos_x - obj->pos_x;
+				double dy = other->pos_y - obj->pos_y;
+
+				// If necessary adjust for closest image.
+				if(a_config->is_periodic){
+					dx -= a_config->width() * round( dx/a_config->width() );
+					dy -= a_config->height() * round( dy/a_config->height() );
+				}
+
+				// Coordinates in the frame of the object.
+				double u = dx * s + dy * c;
+				double v = dx * c - dy * s;
+
+				bin_x = floor( bin_xmax * (extent+u+spec.dist/2.0)/(2.0*extent));
+				bin_y = floor( bin_ymax * (extent+v+spec.dist/2.0)/(2.0*extent));
+				if(( bin_x < 0 ) || ( bin_x >= bin_xmax ) || ( bin_y < 0 ) || ( bin_y >= bin_ymax ))
+					continue;					// Outside the map
+				// Increment array of n
+				int	m = bin_x*bin_ymax+bin_y;
+				maps.n_array[m] += 1.0;
+				// Calculate relative orientation dx, dy including symmetry rotation #
+				double theta = obj->orientation - other->orientation;
+				theta *= spec.rotation;
+
+				// Increment dx, dy arrays
+				maps.dx_array[m] += sin(theta);
+				maps.dy_array[m] += cos(theta);
+			}
+		}
+	}
+	// Each type2 object expects the same map so add it once, weighted
+	int	n_cells = bin_xmax*bin_ymax;
+	for(int m=0; m < n_cells; m++)
+		maps.e_array[m] += fr.n_type2 * de[m];
+}
+
+/***
+ * @brief analyse_batch() Treat all the type1 objects of a batch of frames.
+ * The objects are taken OBJECTS_PER_TASK at a time by the worker threads.
+ */
+void
+analyse_batch( std::vector<frame *>& batch, const map_spec& spec, const std::vector<double>& de_uniform,
+               std::vector<order_maps>& maps, std::vector<area_cache>& cache )
+{
+	std::vector< std::pair<int,int> >	tasks;		// Frame and object
+	std::atomic<size_t>	next(0);
+	int	n_threads = maps.size();
+
+	for( size_t f = 0; f < batch.size(); f++ )
+		for(int i = 0; i < batch[f]->a_config->n_objects(); i++ )
+			if( batch[f]->a_config->get_object(i)->o_type == spec.type1 )
+				tasks.push_back( std::make_pair( (int) f, i ));
+
+	auto worker = [&]( int t ){
+		size_t	first;
+		while(( first = next.fetch_add( OBJECTS_PER_TASK )) < tasks.size() ){
+			size_t	last = std::min( first + OBJECTS_PER_TASK, tasks.size() );
+			for( size_t n = first; n < last; n++ )
+				analyse_object( *batch[tasks[n].first], tasks[n].second, spec, de_uniform, maps[t], cache[t] );
+		}
+	};
+	if( n_threads == 1 ){
+		worker( 0 );
+	} else {
+		std::vector<std::thread>	threads;
+		for(int t = 0; t < n_threads; t++ ) threads.emplace_back( worker, t );
+		for( std::thread& th : threads ) th.join();
+	}
+	for( frame *fr : batch ) delete fr;
+	batch.clear();
+}
+
 /***
  * Main program
  */
@@ -54,10 +349,13 @@ main( int argc, char **argv )
 	int		type2		= 0;
 	bool	verbose		= false;
 	bool	trajectory	= false;
+	double	quantum		= -1.0;
+	double	max_dist	= 0.0;
+	int		n_threads	= 1;
 	char	c;
 	
     // Getopt based argument handling.
-    while( ( c = getopt (argc, argv, "vhzo:d:r:t:u:") ) != -1 )
+    while( ( c = getopt (argc, argv, "vhzo:d:r:t:u:q:m:j:") ) != -1 )
     {
         switch(c)
         {
@@ -78,11 +376,24 @@ main( int argc, char **argv )
             case 'u':				// type 2 object (default 0)
                 if (optarg) type2 = atoi(optarg);
                 break;
+            case 'q':				// Position grid for the area cache
+                if (optarg) quantum = atof(optarg);
+                break;
+            case 'm':				// Limit of the map
+                if (optarg) max_dist = atof(optarg);
+                break;
+            case 'j':				// Number of threads
+                if (optarg) n_threads = atoi(optarg);
+                if( n_threads < 1 ){
+                    std::cerr << "The number of threads must be at least 1\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case 'h':
                 usage();
                 exit(EXIT_SUCCESS);
             case '?':				// Something wrong.
-                if (optopt == 'o' or optopt == 'r' or optopt == 'd' or optopt == 't' or optopt == 'u'){
+                if (optopt == 'o' or optopt == 'r' or optopt == 'd' or optopt == 't' or optopt == 'u' or optopt == 'q' or optopt == 'm' or optopt == 'j'){
                     std::cerr << "The -" << optopt << " option is missing a parameter!\n";
                 } else {
                     std::cerr << "Unknown option " << optopt << "!\n";
@@ -100,6 +411,7 @@ main( int argc, char **argv )
                    << "Rotational parameter is " << rotation << ".\n"
                    << "First object type is  " << type1 << ".\n"
                    << "Second object type is " << type2 << ".\n"
+                   << "Using " << n_threads << " thread(s).\n"
                    << "Sending output to " << ((out_name)?out_name:"str::cout");
          std::cerr << ".\n";
     }
@@ -145,153 +457,58 @@ main( int argc, char **argv )
 
 	if(verbose)
 		std::cerr << "Conditions are " << ((a_config->is_periodic)?" ":"not ") << "periodic\n";
-	// Initialize arrays for accumulating results.
-	double	**e_array;
-	double	**de_array;
-	double	**n_array;
-	double	**dx_array;
-	double	**dy_array;
-	
-	int		bin_x, bin_y, bin_xmax, bin_ymax;
-	double	theta;
+	// Initialize maps for accumulating results. Each map is a single
+	// contiguous array with cell (k,l) at k*bin_ymax+l.
+	map_spec	spec;
 	double	r_max = sqrt(a_config->width()*a_config->width()+a_config->height()*a_config->height());
 	if(a_config->is_periodic) r_max /= 2.0;
-	bin_xmax = bin_ymax = 2*floor(r_max/dist)+1;	// 2 for left and right + 1 for middle		
-	
+	spec.limited  = ( max_dist > 0.0 ) && ( max_dist < r_max );
+	spec.extent   = spec.limited ? max_dist : r_max;
+	spec.dist     = dist;
+	spec.rotation = rotation;
+	spec.type1    = type1;
+	spec.type2    = type2;
+	spec.bin_xmax = spec.bin_ymax = 2*floor(spec.extent/dist)+1;	// 2 for left and right + 1 for middle
+	int		bin_xmax = spec.bin_xmax;
+	int		bin_ymax = spec.bin_ymax;
+	int		n_cells = bin_xmax*bin_ymax;
+
 	if(verbose)
-		std::cerr << "Maximum distance is " << r_max << " maximum bin is " << bin_xmax << ".\n";
-
-	// Allocate arrays
-	e_array  = new double*[bin_xmax];
-	de_array = new double*[bin_xmax];
-	n_array  = new double*[bin_xmax];
-	dx_array = new double*[bin_xmax];
-	dy_array = new double*[bin_xmax];
-	for(int i=0; i< bin_xmax; i++ ){
-		e_array[i]  = new double[bin_ymax];
-		de_array[i] = new double[bin_ymax];
-		n_array[i]  = new double[bin_ymax];
-		dx_array[i] = new double[bin_ymax];
-		dy_array[i] = new double[bin_ymax];
-	}
-	for(int k=0; k < bin_xmax; k++)
-	    for(int l=0; l< bin_ymax; l++){
-	    	e_array[k][l] =
-	    	n_array[k][l] =
-	    	dx_array[k][l] =
-	    	dy_array[k][l] = 0.0;
-	}
-	
+		std::cerr << "Maximum distance is " << spec.extent << " maximum bin is " << bin_xmax << ".\n";
+
+	std::vector<double>		de_array(n_cells, 0.0);		// Fraction of area in each cell (periodic)
+	std::vector<order_maps>	maps(n_threads, order_maps(n_cells));
+
 	if(verbose)
 		std::cerr << "Arrays allocated.\n";
 
-    // For periodic conditions precalculate de array
-    if(a_config->is_periodic){
+	// Areas are reused for objects on the same grid point, the orientation
+	// grid moves the furthest cells by quantum.
+	if( quantum < 0.0 ) quantum = dist/10.0;
+	std::vector<area_cache>	cache;
+	for(int t = 0; t < n_threads; t++ ) cache.emplace_back( quantum, quantum/spec.extent );
+
+    // For periodic conditions over the whole configuration precalculate de array
+    if(a_config->is_periodic && !spec.limited){
     	for(int k=0; k < bin_xmax; k++)
     	    for(int l=0; l< bin_ymax; l++){
-    	        de_array[k][l] = (1.00/((bin_xmax-1.00)*(bin_ymax-1.00)));
-    	        if(k == 0)            de_array[k][l] /= 2.0;
-    	        if(l == 0)            de_array[k][l] /= 2.0;
-    	        if(k == (bin_xmax-1)) de_array[k][l] /= 2.0;
-    	        if(l == (bin_ymax-1)) de_array[k][l] /= 2.0;
+    	        double	*de = &de_array[k*bin_ymax+l];
+    	        *de = (1.00/((bin_xmax-1.00)*(bin_ymax-1.00)));
+    	        if(k == 0)            *de /= 2.0;
+    	        if(l == 0)            *de /= 2.0;
+    	        if(k == (bin_xmax-1)) *de /= 2.0;
+    	        if(l == (bin_ymax-1)) *de /= 2.0;
     	    }
 		if(verbose)
 			std::cerr << "Precalculated de_array for periodic conditions.\n";
     }
-    
+
+    std::vector<frame *>	batch;
     do {
-    	for(int i = 0; i < a_config->n_objects(); i++ ){
-    		if(a_config->get_object(i)->o_type == type1 ){
-    			// Calculate de_array if necessary (non-periodic conditions)
-    			if(!a_config->is_periodic){
-					bool is_inside;
-   					int	counter = 0;
-					double x, y;
-    				for(int k=0; k < bin_xmax; k++){
-    					for(int l=0; l < bin_ymax; l++){
-    						de_array[k][l] = 0.0;
-    					}
-    				}
-					{
-    					int n_tries = (a_config->width()/dist)*(a_config->height()/dist);	// Maximum number of bins
-    					n_tries *= 1000;													// Factor determining precision
-    					for(int k=0; k<n_tries; k++){
-    						x = rnd_lin(a_config->width());
-    						y = rnd_lin(a_config->height());
-    						if(a_config->is_rectangle){
-    							is_inside = true;
-    						} else {
-    							x += a_config->poly->x_min();
-    							y += a_config->poly->y_min();
-    							is_inside = a_config->poly->is_inside(x,y);
-    						}
-    						if(is_inside){
-	    						// Calculate bin number.    					
-    							double dx = a_config->get_object(i)->pos_x - x;
-    							double dy = a_config->get_object(i)->pos_y - y;
-	    						theta = atan2(dy, dx);
-    							theta += a_config->get_object(i)->orientation;
-    							double r = sqrt(dx*dx+dy*dy);
-    							dx = r * sin(theta);
-    							dy = r * cos(theta);
-
-    							bin_x = floor( bin_xmax * (r_max+dx+dist/2.0)/(2.0*r_max));
-    							bin_y = floor( bin_ymax * (r_max+dy+dist/2.0)/(2.0*r_max));
-    							de_array[bin_x][bin_y] += 1.0;
-    							counter++;
-    						}
-    					}
-    				}
-    				for(int k=0; k < bin_xmax; k++){
-    					for(int l=0; l < bin_ymax; l++){
-    						de_array[k][l] = de_array[k][l]/counter;
-    					}
-    				}
-    			}
-    			for(int j = 0; j < a_config->n_objects(); j++ ){
-    				if(a_config->get_object(j)->o_type == type2 ){
-   					
-    					// Calculate bin number.    					
-    					double dx = a_config->get_object(j)->pos_x - a_config->get_object(i)->pos_x;
-    					double dy = a_config->get_object(j)->pos_y - a_config->get_object(i)->pos_y;
-    					
-    					// If necessary adjust for closest image.
-    					if(a_config->is_periodic){
-    						if( dx >  a_config->width() /2.0 ) dx -= a_config->width() /2.0; 
-    						if( dy >  a_config->height()/2.0 ) dy -= a_config->height()/2.0; 
-    						if( dx < -a_config->width() /2.0 ) dx += a_config->width() /2.0; 
-    						if( dy < -a_config->height()/2.0 ) dy += a_config->height()/2.0; 
-    					}
-    					
-    					theta = atan2(dy, dx);
-    					theta += a_config->get_object(i)->orientation;
-    					double r = sqrt(dx*dx+dy*dy);
-    					dx = r * sin(theta);
-    					dy = r * cos(theta);
-
-    					bin_x = floor( bin_xmax * (r_max+dx+dist/2.0)/(2.0*r_max));
-    					bin_y = floor( bin_ymax * (r_max+dy+dist/2.0)/(2.0*r_max));
-    					// Increment arrays of <n>, n
-    					n_array[bin_x][bin_y] += 1.0;
-    					for(int k=0; k < bin_xmax; k++)
-    					    for(int l=0; l < bin_ymax; l++ )
-    					        e_array[k][l] += de_array[k][l];
-    					// Calculate relative orientation dx, dy including symmetry rotation #
-    					theta = a_config->get_object(i)->orientation - a_config->get_object(j)->orientation;
-    					theta *= rotation;
-    					
-    					// Increment dx, dy arrays
-    					dx_array[bin_x][bin_y] += sin(theta);
-    					dy_array[bin_x][bin_y] += cos(theta);
-    				}
-    			}
-    		}
-    	}
-    	
+    	batch.push_back( new frame( a_config, spec ));		// The frame now owns the configuration
     	// Finished with this configuration move on to next if there is one.
     	// (currently normal file termination and error conditions are not properly distinguished)
     	
-    	delete a_config;
     	a_config = (config *)NULL;
     	
     	// Try to read a new configuration from trajectory
@@ -344,7 +561,25 @@ main( int argc, char **argv )
     			}
     		}
     	}
+    	if(( a_config == (config *)NULL ) || ( (int) batch.size() >= FRAMES_PER_THREAD * n_threads )){
+    		if(verbose)
+    			std::cerr << "Treating a batch of " << batch.size() << " frames.\n";
+    		analyse_batch( batch, spec, de_array, maps, cache );
+    	}
     } while ( a_config != (config *)NULL );
+
+    // Sum the maps of the different threads
+    for(int t = 1; t < n_threads; t++ )
+    	for(int m = 0; m < n_cells; m++ ){
+    		maps[0].e_array[m]  += maps[t].e_array[m];
+    		maps[0].n_array[m]  += maps[t].n_array[m];
+    		maps[0].dx_array[m] += maps[t].dx_array[m];
+    		maps[0].dy_array[m] += maps[t].dy_array[m];
+    	}
+    std::vector<double>&	e_array  = maps[0].e_array;
+    std::vector<double>&	n_array  = maps[0].n_array;
+    std::vector<double>&	dx_array = maps[0].dx_array;
+    std::vector<double>&	dy_array = maps[0].dy_array;
     
     if(verbose)
     	std::cerr << "Calculations finished... writing results.\n";
@@ -364,26 +599,14 @@ main( int argc, char **argv )
 	dest << bin_xmax << " " << bin_ymax << "\n";
     for(int k=0; k < bin_xmax; k++)
         for(int l=0; l < bin_ymax; l++){
-        	dest << k << " " << l << " " << n_array[k][l]/e_array[k][l] << " " 
-        	     << e_array[k][l] << " " << dx_array[k][l] << " " << dy_array[k][l] << "\n";
+        	int m = k*bin_ymax+l;
+        	dest << k << " " << l << " " << n_array[m]/e_array[m] << " "
+        	     << e_array[m] << " " << dx_array[m] << " " << dy_array[m] << "\n";
         }
 
     if(out_name) of.close();
     
     if(verbose)
     	std::cerr << "Output finished... tidying up.\n";
-    	
-    for(int i=0; i< bin_xmax; i++ ){
-		delete[] e_array[i];
-		delete[] de_array[i];
-		delete[] n_array[i];
-		delete[] dx_array[i];
-		delete[] dy_array[i];
-	}
 
-	delete[] e_array;
-	delete[] de_array;
-	delete[] n_array;
-	delete[] dx_array;
-	delete[] dy_array;
 }
@@ -1,74 +1,299 @@
 /**
  * @brief Calculate the pair correlation function for a collection of distributions
+ *
+ * The configurations can be read from a series of configuration files,
+ * from compressed trajectory files (as written by NVT) or from the standard
+ * input, and a subset of the frames selected with -f first:last:stride.
+ * Frames are read in batches by the main thread and the batch is shared out
+ * between the worker threads (-j), each accumulating its own histograms
+ * that are summed once all the frames have been treated.
  */
- 
+
 #define	MAXBIN		5000
 
 #include "../Classes/config.h"
+#include "../Classes/area_cache.h"
+#include "../Libraries/gzstream.h"
 #include <iostream>
 #include <unistd.h>
 #include <vector>
-#include <random>
+#include <thread>
 
 using namespace std;
 
-#define INTSTEPS (int)(1000*a_config->area()/(M_PI*dr*dr))
+#define FRAMES_PER_THREAD	4		// Frames read per worker in each batch
+
+/**
+ * Counts and expected counts accumulated over frames by one thread.
+ */
+struct histogram {
+    std::vector<long>	count;		// Number found at given distance
+    std::vector<double>	area;		// Number expected at the given distance
+
+    void grow(size_t n){		// Make sure there are at least n bins
+        if( n > count.size() ){
+            count.resize(n, 0);
+            area.resize(n, 0.0);
+        }
+    }
+};
+
+/**
+ * Where the frames come from and which ones to analyse.
+ */
+struct frame_source {
+    int			argc;
+    char		**argv;
+    int			next_file;	// Next file argument to open
+    bool		trajectory;	// Files are compressed trajectories
+    igzstream		traj_stream;	// Current trajectory file
+    std::istream	*stream;	// Current stream (trajectory or stdin), NULL if none
+    long		n_frame;	// Frames seen so far
+    long		first;		// First frame to analyse
+    long		last;		// Stop before this frame (-1 no limit)
+    long		stride;		// Analyse every stride frames
+};
 
 /*
 **	Local routines
 */
 
-double get_random(double low, double high)		// Return a random number uniformly
-{							// distributed between [low and high]
-    static std::default_random_engine e;                // Appears to work.
-    static std::uniform_real_distribution<> dis(0.0, 1.0);
-    double r = dis(e);
-    return low + (high-low) * r;
-}
-
 void
 usage()
 {
-    std::cerr << "Usage: pcf [-v] [-o output] [-r dist] [-t type1] [-u type2] file1...\n" ;
+    std::cerr << "Usage: pcf [-v] [-z] [-o output] [-r dist] [-t type1] [-u type2] [-f first:last:stride] [-j threads] [-q grid] file1...\n" ;
     std::cerr << "-v verbose output to stderr,\n" ;
+    std::cerr << "-z the input files are compressed trajectory files,\n" ;
     std::cerr << "-o output send output to file output (default stdout),\n" ;
     std::cerr << "-r dist set the integration bin size to dist (default 1.0),\n" ;
     std::cerr << "-t type1 look at distances between objects of this type and type2 (default 0),\n" ;
     std::cerr << "-u type2 look at distances between objects of this type and type1 (default 0),\n" ;
-    std::cerr << "file1... series of configuration files to read, if none are given use stdin.\n" ;
+    std::cerr << "-f first:last:stride analyse frames first, first+stride... before last (default all),\n" ;
+    std::cerr << "-j threads number of frames to treat in parallel (default 1),\n" ;
+    std::cerr << "-q grid reuse area normalisations for objects on the same grid point, 0 for exact (default dist/10),\n" ;
+    std::cerr << "file1... series of configuration or trajectory files to read, if none are given use stdin.\n" ;
+}
+
+/**
+ * Parse a frame selection first:last:stride, any field can be omitted.
+ * @return true if the selection is valid.
+ */
+bool
+parse_frames(const char *spec, long *first, long *last, long *stride)
+{
+    char	*end;
+    long	value[3] = { 0, -1, 1 };
+
+    for( int i = 0; i < 3; i++ ){
+        if(( *spec != ':' ) && ( *spec != '\0' )){
+            value[i] = strtol( spec, &end, 10 );
+            if( end == spec ) return false;
+            spec = end;
+        }
+        if( *spec == '\0' ) break;
+        if(( *spec != ':' ) || ( i == 2 )) return false;
+        spec++;
+    }
+    if(( value[0] < 0 ) || ( value[2] <= 0 )) return false;
+    *first  = value[0];
+    *last   = value[1];
+    *stride = value[2];
+    return true;
+}
+
+/**
+ * Read the next configuration in a stream, skipping any frame separators.
+ * @return the configuration or NULL at the end of the stream.
+ */
+config *
+read_frame(std::istream& src)
+{
+    std::string	line;
+
+    src >> std::ws;
+    while( src.peek() == '=' ){			// Frame separator ====step====
+        getline( src, line );
+        src >> std::ws;
+    }
+    if( src.eof() ) return (config *)NULL;
+    return new config( src );
+}
+
+/**
+ * Get the next frame from the input, whether selected or not.
+ * @return the configuration, or NULL when there are no more.
+ * Errors in reading a file throw a runtime_error.
+ */
+config *
+next_frame(frame_source& in)
+{
+    config	*a_config;
+
+    for(;;){
+        if( in.stream ){
+            if(( a_config = read_frame( *in.stream )) != NULL ) return a_config;
+            if( in.stream == &std::cin ) return (config *)NULL;
+            in.traj_stream.close();
+            in.stream = (std::istream *)NULL;
+        }
+        if( in.next_file >= in.argc ) return (config *)NULL;
+        if( !in.trajectory ) return new config( in.argv[ in.next_file++ ] );
+        in.traj_stream.open( in.argv[ in.next_file ] );
+        if( !in.traj_stream.good() )
+            throw runtime_error( string("Unable to open trajectory ") + in.argv[ in.next_file ] + "\n" );
+        in.next_file++;
+        in.stream = &in.traj_stream;
+    }
+}
+
+/**
+ * Get the next frame that is selected for analysis.
+ * @return the configuration, or NULL when there are no more.
+ */
+config *
+next_selected(frame_source& in)
+{
+    config	*a_config;
+
+    for(;;){
+        if(( in.last >= 0 ) && ( in.n_frame >= in.last )) return (config *)NULL;
+        if(( a_config = next_frame( in )) == NULL ) return (config *)NULL;
+        long frame = in.n_frame++;
+        if(( frame >= in.first ) && ((( frame - in.first ) % in.stride ) == 0 )) return a_config;
+        delete a_config;
+    }
+}
+
+/**
+ * Accumulate the distances between type1 and type2 objects of a
+ * configuration and the corresponding expected numbers.
+ * @param a_config the configuration to analyse.
+ * @param hist the histograms to increment.
+ * @param cache areas already calculated for the container.
+ */
+void
+analyse_frame(config *a_config, int type1, int type2, double dr, histogram& hist, area_cache& cache)
+{
+    polygon		*container = a_config->poly;
+    polygon		rectangle;
+    std::vector<double>	d_area;		// Fraction of area at given distance - sum = 1.0
+    double		rmax, r;
+    double		x, y, x2, y2;
+    int			maxbin, bin;
+    int			n_type2;
+
+    /// Adjust vector sizes if necessary.
+    if( a_config->is_rectangle){
+        rmax = sqrt( a_config->x_size * a_config->x_size + a_config->y_size * a_config->y_size );
+        if( a_config->is_periodic ) rmax /= 2.0;
+    } else {
+        rmax = a_config->poly->max_dist();
+    }
+    maxbin = 1 + floor( rmax/dr );
+    if( !container ){			// A closed rectangular box
+        rectangle.add_vertex( 0.0, 0.0 );
+        rectangle.add_vertex( a_config->x_size, 0.0 );
+        rectangle.add_vertex( a_config->x_size, a_config->y_size );
+        rectangle.add_vertex( 0.0, a_config->y_size );
+        container = &rectangle;
+    }
+    hist.grow( maxbin );
+    d_area.assign( maxbin, 0.0 );
+
+    if( a_config->is_periodic ){ 		// Fill in d_area array Maths is rather inaccurate
+        for( int i=0; i< maxbin; i++ ){         // TODO Need to improve accuracy in corner regions
+            double theta1 = 0.0;
+            double theta2 = M_PI/2.0;
+            if( i * dr > a_config->x_size / 2.0 ) theta1 = acos( a_config->x_size / (2.0 * i * dr ));
+            if( i * dr > a_config->y_size / 2.0 ) theta2 = M_PI/2.0 - acos( a_config->y_size / (2.0 * i * dr ));
+            d_area[i] = dr * dr * (2*i+1) * (theta2 - theta1) * 2.0;
+            d_area[i] /= a_config->area();
+        }
+    }
+
+    n_type2 = 0;
+    for(int i=0; i< a_config->n_objects(); i++ )
+        if(a_config->get_object(i)->o_type == type2) n_type2++;
+    if( n_type2 == 0 ) return;
+
+    /// Loop over objects in configuration
+    for(int i=0; i< a_config->n_objects(); i++ )
+        if( a_config->get_object(i)->o_type == type1 ){
+        x = a_config->get_object(i)->pos_x;
+        y = a_config->get_object(i)->pos_y;
+        //// Add to areas array
+        if( ! a_config->is_periodic ){		// Can't use precalculated array as d_area depends on x,y
+            std::vector<double>	*ring;
+            double		xc = x;
+            double		yc = y;
+            if( !cache.lookup( container, &xc, &yc, NULL, &ring )){
+                double inner = 0.0;		// Exact area of container within each ring
+                ring->resize( maxbin );
+                for( int j=0; j< maxbin; j++ ){
+                    double outer = container->circle_area( xc, yc, (j+1)*dr );
+                    (*ring)[j] = ( outer - inner )/a_config->area();
+                    inner = outer;
+                }
+            }
+            d_area = *ring;
+        }
+        for( int j=0; j< maxbin; j++ ){         // Add probable number at each distance...
+            hist.area[j] += d_area[j] * n_type2 ;
+        }
+        //// Loop over other objects and add to count array
+        for(int j=((type1==type2)?i:0); j<a_config->n_objects(); j++ ){
+            if( a_config->get_object(j)->o_type == type2 ){
+            x2 = a_config->get_object(j)->pos_x;
+            y2 = a_config->get_object(j)->pos_y;
+
+            // If periodic get closest image to x,y
+            if( a_config->is_periodic ){
+               if(  x2 < x ) x2 += a_config->x_size;
+               if(( x2 - x ) > (x - x2 + a_config->x_size)) x2 -= a_config->x_size;
+               if(  y2 < y ) y2 += a_config->y_size;
+               if(( y2 - y ) > (y - y2 + a_config->y_size)) y2 -= a_config->y_size;
+            }
+
+            r = (x2 - x)*(x2 - x)+(y2 - y)*(y2 - y);
+            r = sqrt(r);
+            bin = floor( r/dr );
+            assert( bin < maxbin );
+            hist.count[bin]++;
+            if((type1 == type2) && (i != j)) hist.count[bin]++;
+        }}
+    }
 }
 
 int
 main( int argc, char **argv )
 {
-    config      	*a_config = (config *)NULL;
     bool		verbose = false;
     char        	c;
     char		*out_name = (char *)NULL;
     int			type1 = 0;
     int         	type2 = 0;
+    int			n_threads = 1;
     double		dr = 1;
-    double		r;
-    int 		maxbin = 0;
-    int 		newmax;
-    int			bin;
-    double		rmax;
-    std::vector<int>	count;		// Number found at given distance
-    std::vector<double>	area;		// Number expected at the given distance
-    std::vector<double>	d_area;		// Fraction of area at given distance - sum = 1.0
-    int			n_type2;
-    double		x, y, x2, y2;
+    double		quantum = -1.0;
+    frame_source	in;
+
+    in.trajectory = false;
+    in.stream     = (std::istream *)NULL;
+    in.n_frame    = 0;
+    in.first      = 0;
+    in.last       = -1;
+    in.stride     = 1;
 
     // Getopt based argument handling.
-    // Need to fix this for this programme...
-    while( ( c = getopt (argc, argv, "vho:r:t:u:") ) != -1 )
+    while( ( c = getopt (argc, argv, "vhzo:r:t:u:f:j:q:") ) != -1 )
     {
         switch(c)
         {
             case 'v': verbose = true; break;
+            case 'z': in.trajectory = true; break;
             case 'r':				// step size
                 if (optarg) dr = atof(optarg);  //TODO should check its a number
-                break;            
+                break;
             case 'o':				// Output file (default stdout)
                 if (optarg) out_name = optarg;
                 break;
@@ -78,196 +303,123 @@ main( int argc, char **argv )
             case 'u':				// type 2 object (default 0)
                 if (optarg) type2 = atoi(optarg);
                 break;
+            case 'f':				// Frame selection
+                if (optarg && !parse_frames(optarg, &in.first, &in.last, &in.stride)){
+                    std::cerr << "Invalid frame selection " << optarg << ", expected first:last:stride\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':				// Number of threads
+                if (optarg) n_threads = atoi(optarg);
+                if( n_threads < 1 ){
+                    std::cerr << "The number of threads must be at least 1\n";
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'q':				// Position grid for the area cache
+                if (optarg) quantum = atof(optarg);
+                break;
             case 'h':
                 usage();
                 exit(EXIT_SUCCESS);
             case '?':				// Something wrong.
-                if (optopt == 'o' or optopt == 'r' or optopt == 't' or optopt == 'u'){
-                    std::cerr << "The -" << optopt << " option is missing a parameter!\n";
+                if (optopt == 'o' or optopt == 'r' or optopt == 't' or optopt == 'u' or optopt == 'f' or optopt == 'j' or optopt == 'q'){
+                    std::cerr << "The -" << (char)optopt << " option is missing a parameter!\n";
                 } else {
-                    std::cerr << "Unknown option " << optopt << "!\n";
+                    std::cerr << "Unknown option " << (char)optopt << "!\n";
                 }
             default :                           // Something very wrong.
                 usage();
                 exit(EXIT_FAILURE);
         }
     }
+    if( quantum < 0.0 ) quantum = dr/10.0;
     if( verbose ){
          std::cerr << "Verbose flag is set.\n";
          std::cerr << "Step size is " << dr << ".\n";
          std::cerr << "First object type is  " << type1 << ".\n";
          std::cerr << "Second object type is " << type2 << ".\n";
+         std::cerr << "Frames " << in.first << ":" << in.last << ":" << in.stride
+                   << " using " << n_threads << " thread(s).\n";
+         std::cerr << "Area cache grid is " << quantum << ".\n";
     }
 
-// TODO Should seed random number generator somewhere here.
-
-// Read in the first configuration
-
-    try{
-        if(( argc - optind ) > 0 ){	                // Read source configuration
-            a_config = new config( argv[ optind ] );
-            if( verbose )
-                std::cerr << "Input read from " << argv[ optind ] << "\n";
-            optind++;
-        } else {					
-            a_config = new config(std::cin);
-            if( verbose )
-                std::cerr << "Input read from 'stdin'\n";
+    in.argc      = argc;
+    in.argv      = argv;
+    in.next_file = optind;
+    if( optind == argc ){			// No files so read stdin
+        if( in.trajectory ){
+            std::cerr << "Compressed trajectories must be given as files\n";
+            exit(EXIT_FAILURE);
         }
-    }
-    catch(...){
-        std::cerr << "Failed to read first configuration\n";
-        std::cerr << "Program exiting\n";
-        if( a_config ){
-            delete a_config;
-        }
-        exit(EXIT_FAILURE);        
+        in.stream = &std::cin;
+        if( verbose )
+            std::cerr << "Input read from 'stdin'\n";
     }
 
-    // Set up initial vectors for count and area... 
+    // Each thread has its own histograms and area cache.
+    std::vector<histogram>	hist(n_threads);
+    std::vector<area_cache>	cache;
+    for( int t = 0; t < n_threads; t++ ) cache.emplace_back( quantum );
 
-    // Start while loop over input files...
-    do {
-        if(verbose)
-            std::cerr << "Starting treatment of first configuration\n";
-        /// Adjust vector sizes if necessary.
-        if( a_config->is_rectangle){
-            rmax = sqrt( a_config->x_size * a_config->x_size + a_config->y_size * a_config->y_size );
-            if( a_config->is_periodic ) rmax /= 2.0;
-        } else {
-            rmax = a_config->poly->max_dist();
-        }
-        newmax = 1 + floor( rmax/dr );
-        if( newmax > maxbin ){
-            count.resize(newmax);
-            area.resize(newmax);
-            d_area.resize(newmax);
-            for(int i=maxbin; i<newmax; i++ ){
-                count[i]  = 0;
-                area[i]   = 0.0;
-                d_area[i] = 0.0;
-            }
-            maxbin = newmax;
-        }
-
-        if(verbose)
-            std::cerr << "Array sizes adjusted "<< a_config->area() << "\n";
-
-        if( a_config->is_periodic ){ 		// Fill in d_area array Maths is rather inaccurate
-	    for( int i=0; i< maxbin; i++ ){     // TODO Need to improve accuracy in corner regions
-                double theta1 = 0.0;
-                double theta2 = M_PI/2.0;
-                if( i * dr > a_config->x_size / 2.0 ) theta1 = acos( a_config->x_size / (2.0 * i * dr ));
-                if( i * dr > a_config->y_size / 2.0 ) theta2 = M_PI/2.0 - acos( a_config->y_size / (2.0 * i * dr ));
-                d_area[i] = dr * dr * (2*i+1) * (theta2 - theta1) * 2.0;
-                d_area[i] /= a_config->area();
-            }
-        }
+    // Loop over batches of frames until no more data to analyse
+    std::vector<config *>	batch;
+    long			n_analysed = 0;
+    bool			more = true;
 
-        if(verbose){
-            double sum = 0.0;
-            for(int i=0; i<maxbin; i++){
-                sum += d_area[i];
-        ///        fprintf(stderr,"%d\t%d\t%g\t%g\n", i, count[i] , area[i], d_area[i] );
+    while( more ){
+        try{
+            while(( (int) batch.size() < FRAMES_PER_THREAD * n_threads ) && more ){
+                config *a_config = next_selected( in );
+                if( a_config ) batch.push_back( a_config );
+                else more = false;
             }
-            std::cerr << "Sum of d_areas is " << sum << "(should be 1.0 or 0.0)\n";
-            std::cerr << "Starting loop over objects\n";
         }
-        n_type2 = 0;
-        for(int i=0; i< a_config->n_objects(); i++ )
-            if(a_config->get_object(i)->o_type == type2) n_type2++;
-
-        /// Loop over objects in configuration
-        if( n_type2 > 0 )
-        for(int i=0; i< a_config->n_objects(); i++ )
-            if( a_config->get_object(i)->o_type == type1 ){
-            if(verbose) std::cerr << "Found object #" << i << "\n";
-            x = a_config->get_object(i)->pos_x;
-            y = a_config->get_object(i)->pos_y;
-            //// Add to areas array
-            if( ! a_config->is_periodic ){	// Can't use precalculated array as d_area depends on x,y
-                if(verbose) std::cerr << "Calculating d_area array\n";
-                for( int j=0; j< maxbin; j++ ) d_area[j] = 0.0;
-                double x2, y2;
-                double xmin = a_config->poly->x_min();
-                double xmax = a_config->poly->x_max();
-                double ymin = a_config->poly->y_min();
-                double ymax = a_config->poly->y_max();
-                if(verbose) std::cerr << "Area x=" << xmin << "," << xmax << ", y=" << ymin << "," << ymax << "\n";
-                if(verbose) std::cerr << "Finding " << INTSTEPS << " points.\n";
-       		// Fill d_area for x,y point with probablity at dist...
-                for( int j=0; j<INTSTEPS; j++ ){
-       		    // get a point in the polygon
-                    do{
-                        x2 = get_random(xmin, xmax);
-                        y2 = get_random(ymin, ymax);
-                    } while( ! a_config->poly->is_inside(x2,y2) );
-       		    // calculate r and increment appropriate d_area and sum
-                    r = (x2 - x)*(x2 - x)+(y2 - y)*(y2 - y);
-                    r = sqrt(r);
-                    bin = floor( r/dr );
-                    d_area[bin] += 1.0/INTSTEPS;
-                }
-            }
-            if(verbose) std::cerr << "Incrementing areas #" << i << "\n";
-            for( int j=0; j< maxbin; j++ ){     // Add probable number at each distance...
-                area[j] += d_area[j] * n_type2 ;
-            }
-            //// Loop over other objects and add to count array
-            for(int j=((type1==type2)?i:0); j<a_config->n_objects(); j++ ){
-                if(verbose) std::cerr << "." << j ;
-                if( a_config->get_object(j)->o_type == type2 ){
-                x2 = a_config->get_object(j)->pos_x;
-                y2 = a_config->get_object(j)->pos_y;
-
-                // If periodic get closest image to x,y
-                if( a_config->is_periodic ){
-                   if(  x2 < x ) x2 += a_config->x_size;
-                   if(( x2 - x ) > (x - x2 + a_config->x_size)) x2 -= a_config->x_size;
-                   if(  y2 < y ) y2 += a_config->y_size;
-                   if(( y2 - y ) > (y - y2 + a_config->y_size)) y2 -= a_config->y_size;
-                }
-
-                r = (x2 - x)*(x2 - x)+(y2 - y)*(y2 - y);
-                r = sqrt(r);
-                bin = floor( r/dr );
-                assert( bin <= maxbin );
-                count[bin]++;
-                if((type1 == type2) && (i != j)) count[bin]++;
-            }}
-            if(verbose) std::cerr << "\nFinished with #" << i << "\n";
+        catch( exception& e ){
+            std::cerr << "Failed to read frame " << in.n_frame << ": " << e.what();
+            std::cerr << "Program exiting\n";
+            for( config *a_config : batch ) delete a_config;
+            exit(EXIT_FAILURE);
         }
-        /// Read in the next configuration if any
-
+        if( batch.empty() ) break;
         if(verbose)
-            std::cerr << "Look for another file\n";
+            std::cerr << "Treating " << batch.size() << " frames up to frame " << in.n_frame - 1 << "\n";
 
-        delete a_config;
-        a_config = (config *)NULL;
-        try{
-            if(( argc - optind ) > 0 ){	                // Read source configuration
-                a_config = new config( argv[ optind ] );
-                if( verbose )
-                    std::cerr << "Input read from " << argv[ optind ] << "\n";
-            }
-        }
-        catch(...){
-            std::cerr << "Failed to read configuration from " << argv[ optind ] << "\n";
-            std::cerr << "Program exiting\n";
-            if( a_config ){
-                delete a_config;
-                a_config = (config *)NULL;
-            }
+        auto worker = [&]( int t ){
+            for( size_t k = t; k < batch.size(); k += n_threads )
+                analyse_frame( batch[k], type1, type2, dr, hist[t], cache[t] );
+        };
+        if( n_threads == 1 ){
+            worker( 0 );
+        } else {
+            std::vector<std::thread>	threads;
+            for( int t = 0; t < n_threads; t++ ) threads.emplace_back( worker, t );
+            for( std::thread& th : threads ) th.join();
         }
-        optind++;
+        n_analysed += batch.size();
+        for( config *a_config : batch ) delete a_config;
+        batch.clear();
+    }
+    if( n_analysed == 0 ){
+        std::cerr << "Failed to read any configuration\n";
+        std::cerr << "Program exiting\n";
+        exit(EXIT_FAILURE);
+    }
 
-    // End while loop over files when no more data to analyse
-    } while (a_config != (config *)NULL );
+    // Sum the histograms of the different threads
+    histogram	total;
+    for( int t = 0; t < n_threads; t++ ){
+        total.grow( hist[t].count.size() );
+        for( size_t i = 0; i < hist[t].count.size(); i++ ){
+            total.count[i] += hist[t].count[i];
+            total.area[i]  += hist[t].area[i];
+        }
+    }
 
     // Output the datafile to out_file or std::cout
 
     if(verbose)
-        std::cerr << "Output results\n";
+        std::cerr << "Output results from " << n_analysed << " frames\n";
 
     FILE *dest = stdout;
     if(out_name != NULL){			// Open output stream if necessary
@@ -277,15 +429,15 @@ main( int argc, char **argv )
             dest = stdout;
         }
     }
-   
+
     assert( dest );
 
     //Should check area array is non-zero... truncate might be necessary
     //Write out r g(r) n(r) A(r)
 
-    for(int i=0; i<maxbin; i++){
-        if( count[i] == 0 && area[i] == 0.0 ) break;
-        fprintf(dest,"%f\t%g\t%d\t%g\n", (i+0.5)*dr, count[i]/area[i], count[i] , area[i] );
+    for(size_t i=0; i<total.count.size(); i++){
+        if( total.count[i] == 0 && total.area[i] == 0.0 ) break;
+        fprintf(dest,"%f\t%g\t%ld\t%g\n", (i+0.5)*dr, total.count[i]/total.area[i], total.count[i] , total.area[i] );
     }
 
     if( dest != stdout ) fclose( dest );
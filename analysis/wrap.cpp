@@ -98,7 +98,7 @@ main( int argc, char **argv )
     // Output the result...
 
     try{
-    	a_config->write(std::cout);				// Write new configuration to std::cout
+    	a_config->write(stdout);				// Write new configuration to stdout (fprintf is much faster than boost::format)
     }
     catch(...){
         std::cerr << "Failed while writing new configuration, "
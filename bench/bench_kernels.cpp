@@ -0,0 +1,320 @@
+/**
+ * @file    bench_kernels.cpp
+ * @brief   Micro-benchmarks of the core kernels.
+ *
+ * Times the kernels that dominate the simulation and analysis programmes
+ * on synthetic configurations (see synthetic.h) for every combination of
+ * the requested numbers of objects, atoms per molecule and packing
+ * fractions. Each result is written as one JSON object per line so that
+ * runs can be compared between releases.
+ *
+ * See bench.md for details of usage and of the output.
+ */
+
+#include "synthetic.h"
+#include "../Classes/common.h"
+#include "../Libraries/gzstream.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#define N_SAMPLES       1024        // Distances, pairs or points per call of a kernel.
+#define N_PROBES        256         // Insertion attempts per call of test_clash.
+#define TRAJ_FRAMES     5           // Frames per trajectory write or read.
+
+void
+usage()
+{
+    std::cerr << "Usage: bench_kernels [-v][-n sizes][-a atoms][-d fractions][-k kernels]"
+        << "[-r repeats][-m min_time][-S seed][-T traj_file][-o output]\n";
+}
+
+/**
+ * Time a kernel. The kernel is called until at least min_time seconds have
+ * passed, doubling the number of calls each time, and the best rate of
+ * several such runs is kept.
+ * @param kernel the operation, its result is accumulated in sink so that
+ *        the work can not be discarded.
+ * @param per_call the number of elementary operations in one call.
+ * @return nanoseconds per elementary operation.
+ */
+template<typename F> double
+time_kernel( F kernel, long per_call, double min_time, int repeats, double *sink )
+{
+    double  best = HUGE_VAL;
+
+    for( int r = 0; r < repeats; r++ ){
+        long    calls = 1;
+        for(;;){
+            double  start = bench_clock();
+            for( long i = 0; i < calls; i++ ) *sink += kernel();
+            double  elapsed = bench_clock() - start;
+            if( elapsed >= min_time ){
+                best = simple_min( best, 1e9 * elapsed / ( calls * per_call ));
+                break;
+            }
+            calls *= 2;
+        }
+    }
+    return best;
+}
+
+/**
+ * @return true if name is one of the comma separated kernels, or if no
+ *         kernels were selected.
+ */
+bool
+selected( const char *kernels, const char *name )
+{
+    if( kernels == NULL ) return true;
+    std::string list = std::string(",") + kernels + ",";
+    return list.find( std::string(",") + name + "," ) != std::string::npos;
+}
+
+/**
+ * Read the frames of a trajectory as the analysis programmes do.
+ * @return the number of objects read.
+ */
+double
+read_trajectory( const char *name )
+{
+    igzstream   source;
+    std::string line;
+    double      n_read = 0.0;
+
+    source.open( name );
+    for(;;){
+        source >> std::ws;
+        while( source.peek() == '=' ){          // Frame separator ====step====
+            getline( source, line );
+            source >> std::ws;
+        }
+        if( source.eof() || !source.good() ) break;
+        config  frame( source );
+        n_read += frame.n_objects();
+    }
+    source.close();
+    return n_read;
+}
+
+int
+main( int argc, char **argv )
+{
+    char        c;
+    bool        verbose    = false;
+    const char  *size_list = "100,400,1600";
+    const char  *atom_list = "1,4,9";
+    const char  *fraction_list = "0.1,0.4";
+    const char  *kernels   = (const char *)NULL;
+    const char  *traj_name = "bench_traj.gz";
+    char        *out_name  = (char *)NULL;
+    int         repeats    = 3;
+    double      min_time   = 0.05;
+    long        seed       = 1;
+    std::vector<double> sizes, atoms, fractions;
+
+    while( ( c = getopt (argc, argv, "hvn:a:d:k:r:m:S:T:o:") ) != -1 )
+    {
+        switch(c)
+        {
+            case 'v': verbose = true; break;
+            case 'n': if (optarg) size_list = optarg; break;
+            case 'a': if (optarg) atom_list = optarg; break;
+            case 'd': if (optarg) fraction_list = optarg; break;
+            case 'k': if (optarg) kernels = optarg; break;
+            case 'r': if (optarg) repeats = std::atoi(optarg); break;
+            case 'm': if (optarg) min_time = std::atof(optarg); break;
+            case 'S': if (optarg) seed = std::atol(optarg); break;
+            case 'T': if (optarg) traj_name = optarg; break;
+            case 'o': if (optarg) out_name = optarg; break;
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default :                           // Something wrong.
+                usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+    try {
+        sizes     = parse_list( size_list );
+        atoms     = parse_list( atom_list );
+        fractions = parse_list( fraction_list );
+    }
+    catch( const std::exception& e ){
+        std::cerr << e.what();
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    if(( repeats <= 0 ) || ( min_time < 0.0 )){
+        std::cerr << "The repeats must be positive and the minimum time not negative.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *dest = stdout;
+    if( out_name && ( dest = fopen( out_name, "w" )) == NULL ){
+        std::cerr << "Unable to open " << out_name << " for writing.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    double  sink = 0.0;
+    for( double n_value : sizes )
+    for( double a_value : atoms )
+    for( double fraction : fractions ){
+        int         n = (int)n_value;
+        const char  *system = system_for_atoms( (int)a_value );
+        if( system == NULL ){
+            std::cerr << "There are no molecules with " << a_value << " atoms, use 1, 4 or 9.\n";
+            exit(EXIT_FAILURE);
+        }
+        config      *a_config;
+        rnd_seed( seed );
+        try {
+            a_config = make_config( system, n, fraction );
+        }
+        catch( const std::exception& e ){
+            std::cerr << e.what();
+            exit(EXIT_FAILURE);
+        }
+        force_field *forces = make_forces( system );
+        topology    *a_topology = make_topology();
+        molecule&   a_molecule = a_topology->molecules( system_molecule( system ));
+        if( verbose )
+            std::cerr << "Timing " << system << " n = " << n << " fraction = " << fraction << "\n";
+
+        auto report = [&]( const char *kernel, const char *unit, double ns ){
+            fprintf( dest, "{\"bench\": \"kernels\", \"kernel\": \"%s\", \"system\": \"%s\", "
+                    "\"n\": %d, \"atoms\": %d, \"fraction\": %g, \"unit\": \"%s\", "
+                    "\"ns_per_op\": %.6g}\n",
+                    kernel, system, n, a_molecule.n_atoms, fraction, unit, ns );
+            fflush( dest );
+        };
+
+        if( selected( kernels, "force_field.interaction" )){
+            std::vector<int>    t1( N_SAMPLES ), i1( N_SAMPLES ), t2( N_SAMPLES );
+            std::vector<double> r( N_SAMPLES );
+            for( int k = 0; k < N_SAMPLES; k++ ){
+                i1[k] = (int)rnd_lin( a_molecule.n_atoms );
+                t1[k] = a_molecule.the_atoms( i1[k] ).type;
+                t2[k] = a_molecule.the_atoms( (int)rnd_lin( a_molecule.n_atoms )).type;
+                r[k]  = rnd_lin( forces->cut_off );
+            }
+            report( "force_field.interaction", "pair", time_kernel( [&](){
+                double sum = 0.0;
+                for( int k = 0; k < N_SAMPLES; k++ )
+                    sum += forces->interaction( t1[k], i1[k], t2[k], r[k] );
+                return sum;
+            }, N_SAMPLES, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "object.interaction" ) && ( n > 1 )){
+            int n_pairs = simple_min( n - 1, N_SAMPLES );   // Lattice neighbours
+            report( "object.interaction", "pair", time_kernel( [&](){
+                double sum = 0.0;
+                for( int k = 0; k < n_pairs; k++ )
+                    sum += a_config->get_object(k)->interaction( forces, a_topology,
+                            a_config->get_object(k+1) );
+                return sum;
+            }, n_pairs, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "config.energy" )){
+            report( "config.energy", "evaluation", time_kernel( [&](){
+                a_config->invalidate_within( HUGE_VAL, 0 );     // Everything again
+                a_config->unchanged = false;
+                return a_config->energy( forces );
+            }, 1, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "config.test_clash" )){
+            a_config->build_grid();
+            report( "config.test_clash", "evaluation", time_kernel( [&](){
+                return (double)a_config->test_clash();
+            }, 1, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "config.test_clash_insert" )){
+            std::vector<object> probes;
+            for( int k = 0; k < N_PROBES; k++ )
+                probes.emplace_back( system_molecule( system ), rnd_lin( a_config->x_size ),
+                        rnd_lin( a_config->y_size ), rnd_lin( M_2PI ));
+            a_config->build_grid();
+            report( "config.test_clash_insert", "probe", time_kernel( [&](){
+                double clashes = 0.0;
+                for( object& probe : probes )
+                    clashes += a_config->test_clash( &probe );
+                return clashes;
+            }, N_PROBES, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "polygon.is_inside" ) ||
+            selected( kernels, "polygon.is_inside_radius" )){
+            polygon star;                       // Concave, fills the box
+            double  side = a_config->x_size;
+            for( int k = 0; k < 22; k++ ){
+                double  radius = 0.5 * side * (( k % 2 ) ? 0.4 : 1.0 );
+                double  angle  = -M_2PI * k / 22;
+                star.add_vertex( 0.5 * side + radius * cos( angle ), 0.5 * side + radius * sin( angle ));
+            }
+            std::vector<double> x( N_SAMPLES ), y( N_SAMPLES );
+            for( int k = 0; k < N_SAMPLES; k++ ){
+                x[k] = rnd_lin( side );
+                y[k] = rnd_lin( side );
+            }
+            double  reach = a_topology->bounding_radius( system_molecule( system ));
+            if( selected( kernels, "polygon.is_inside" ))
+                report( "polygon.is_inside", "point", time_kernel( [&](){
+                    double inside = 0.0;
+                    for( int k = 0; k < N_SAMPLES; k++ ) inside += star.is_inside( x[k], y[k] );
+                    return inside;
+                }, N_SAMPLES, min_time, repeats, &sink ));
+            if( selected( kernels, "polygon.is_inside_radius" ))
+                report( "polygon.is_inside_radius", "point", time_kernel( [&](){
+                    double inside = 0.0;
+                    for( int k = 0; k < N_SAMPLES; k++ ) inside += star.is_inside( x[k], y[k], reach );
+                    return inside;
+                }, N_SAMPLES, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "config.parse" )){
+            std::ostringstream text;
+            a_config->write( text );
+            std::string contents = text.str();
+            report( "config.parse", "configuration", time_kernel( [&](){
+                std::istringstream source( contents );
+                config  copy( source );
+                return (double)copy.n_objects();
+            }, 1, min_time, repeats, &sink ));
+        }
+
+        if( selected( kernels, "trajectory.write" ) || selected( kernels, "trajectory.read" )){
+            auto write_trajectory = [&](){
+                ogzstream   traj_stream;
+                traj_stream.open( traj_name );
+                for( int k = 0; k < TRAJ_FRAMES; k++ ){     // As written by NVT
+                    traj_stream << "====" << k << "====\n";
+                    a_config->write( traj_stream );
+                }
+                traj_stream.close();
+                return 0.0;
+            };
+            if( selected( kernels, "trajectory.write" ))
+                report( "trajectory.write", "frame",
+                        time_kernel( write_trajectory, TRAJ_FRAMES, min_time, repeats, &sink ));
+            else
+                write_trajectory();
+            if( selected( kernels, "trajectory.read" ))
+                report( "trajectory.read", "frame", time_kernel( [&](){
+                    return read_trajectory( traj_name );
+                }, TRAJ_FRAMES, min_time, repeats, &sink ));
+            unlink( traj_name );
+        }
+
+        delete a_topology;
+        delete forces;
+        delete a_config;
+    }
+    if( verbose ) std::cerr << "Check sum " << sink << "\n";
+    if( dest != stdout ) fclose( dest );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file    bench_mc.cpp
+ * @brief   End to end benchmark of the Monte Carlo integration.
+ *
+ * Runs the NVT integrator for a fixed number of steps (or a time limit) on synthetic
+ * configurations (see synthetic.h) for every combination of the requested
+ * systems, numbers of objects and packing fractions, and reports the
+ * throughput as one JSON object per line: steps per second, the
+ * acceptance rate and the time per pair of objects examined by the energy
+ * evaluation.
+ *
+ * See bench.md for details of usage and of the output.
+ */
+
+#include "synthetic.h"
+#include "../Classes/integrator.h"
+#include "../Classes/common.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#define STEP_BLOCK      10          // Steps between checks of the time limit.
+
+void
+usage()
+{
+    std::cerr << "Usage: bench_mc [-v][-q][-W][-O sort_freq][-s systems][-n sizes][-d fractions][-N steps]"
+        << "[-w warm_up][-m max_time][-b beta][-a acceptance][-S seed][-o output]\n";
+}
+
+/**
+ * Run the integrator for a number of steps, or until max_time seconds have
+ * passed, adding the accepted and rejected moves to the tallies. The
+ * integrator resets its own tallies every i_adjust steps, so the run is
+ * cut at these points, and in pieces of at most STEP_BLOCK steps to check
+ * the time. If sort_freq is positive the objects are reordered in memory
+ * every sort_freq steps, as by NVT -O, the reordering is included in the
+ * time.
+ * @return the number of steps made.
+ */
+long
+run_steps( integrator& mc, config **state_h, double beta, long steps,
+        double max_time, long sort_freq, long *n_good, long *n_bad )
+{
+    int     done  = mc.run( state_h, beta, 0.0, 0 );    // Steps so far
+    long    made  = 0;
+    double  start = bench_clock();
+
+    while(( made < steps ) && ( bench_clock() - start < max_time )){
+        int     block = mc.i_adjust - done % mc.i_adjust;
+        block = (int)simple_min( (long)block, steps - made );
+        block = simple_min( block, STEP_BLOCK );
+        if( sort_freq > 0 )
+            block = (int)std::min( (long)block, sort_freq - done % sort_freq );
+        int     good = mc.n_good;               // Already counted
+        int     bad  = mc.n_bad;
+        if( done % mc.i_adjust == 0 ) good = bad = 0;   // Reset on the first step
+        done = mc.run( state_h, beta, 0.0, block );
+        *n_good += mc.n_good - good;
+        *n_bad  += mc.n_bad - bad;
+        made    += block;
+        if(( sort_freq > 0 ) && ( done % sort_freq == 0 )) mc.sort_objects( *state_h );
+    }
+    return made;
+}
+
+int
+main( int argc, char **argv )
+{
+    char        c;
+    bool        verbose    = false;
+    bool        rot_flag   = false;
+    bool        sweep      = false;
+    const char  *system_list = "disc,square,squareplus,aqpz";
+    const char  *size_list = "100,400,1600";
+    const char  *fraction_list = "0.1,0.4";
+    char        *out_name  = (char *)NULL;
+    long        n_steps    = 20000;
+    long        warm_up    = 1000;
+    double      max_time   = 5.0;
+    double      beta       = 1.0;
+    double      target     = 0.0;
+    long        seed       = 1;
+    long        sort_freq  = 0;
+    std::vector<double> sizes, fractions;
+    std::vector<std::string> systems;
+
+    while( ( c = getopt (argc, argv, "hvqWO:s:n:d:N:w:m:b:a:S:o:") ) != -1 )
+    {
+        switch(c)
+        {
+            case 'v': verbose = true; break;
+            case 'q': rot_flag = true; break;
+            case 'W': sweep = true; break;
+            case 'O': if (optarg) sort_freq = std::atol(optarg); break;
+            case 's': if (optarg) system_list = optarg; break;
+            case 'n': if (optarg) size_list = optarg; break;
+            case 'd': if (optarg) fraction_list = optarg; break;
+            case 'N': if (optarg) n_steps = std::atol(optarg); break;
+            case 'w': if (optarg) warm_up = std::atol(optarg); break;
+            case 'm': if (optarg) max_time = std::atof(optarg); break;
+            case 'b': if (optarg) beta = std::atof(optarg); break;
+            case 'a': if (optarg) target = std::atof(optarg); break;
+            case 'S': if (optarg) seed = std::atol(optarg); break;
+            case 'o': if (optarg) out_name = optarg; break;
+            case 'h':
+                usage();
+                return EXIT_SUCCESS;
+            default :                           // Something wrong.
+                usage();
+                exit(EXIT_FAILURE);
+        }
+    }
+    try {
+        sizes     = parse_list( size_list );
+        fractions = parse_list( fraction_list );
+    }
+    catch( const std::exception& e ){
+        std::cerr << e.what();
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    std::istringstream  system_source( system_list );
+    std::string         a_system;
+    while( std::getline( system_source, a_system, ',' )){
+        if( system_molecule( a_system.c_str() ) < 0 ){
+            std::cerr << "Unknown system " << a_system << ", use disc, square, squareplus or aqpz.\n";
+            exit(EXIT_FAILURE);
+        }
+        systems.push_back( a_system );
+    }
+    if(( n_steps <= 0 ) || ( warm_up < 0 ) || ( max_time <= 0.0 ) || ( beta < 0.0 )
+            || ( target < 0.0 ) || ( target >= 1.0 ) || ( sort_freq < 0 )){
+        std::cerr << "The number of steps and the time limit must be positive, the warm up and beta not negative.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *dest = stdout;
+    if( out_name && ( dest = fopen( out_name, "w" )) == NULL ){
+        std::cerr << "Unable to open " << out_name << " for writing.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    for( const std::string& name : systems )
+    for( double n_value : sizes )
+    for( double fraction : fractions ){
+        int         n = (int)n_value;
+        const char  *system = name.c_str();
+        config      *a_config;
+        rnd_seed( seed );
+        try {
+            a_config = make_config( system, n, fraction );
+        }
+        catch( const std::exception& e ){
+            std::cerr << e.what();
+            exit(EXIT_FAILURE);
+        }
+        force_field *forces = make_forces( system );
+        topology    *a_topology = make_topology();
+        int         n_atoms = a_topology->molecules( system_molecule( system )).n_atoms;
+        if( verbose )
+            std::cerr << "Running " << system << " n = " << n << " fraction = " << fraction << "\n";
+
+        double      dl_max = simple_min( a_config->width(), a_config->height() ) / 2.0;
+        a_config->reset_obj_dl_max( (int)dl_max );  // Step sizes set up as by NVT
+        integrator  mc( forces );
+        mc.dl_max         = dl_max;
+        mc.initial_dl_max = dl_max;
+        mc.rot_flag       = rot_flag;
+        mc.sweep          = sweep;
+        if( target > 0.0 ) mc.set_controller( new target_controller( target ));
+        a_config->energy( forces );
+
+        long    n_good = 0, n_bad = 0;
+        run_steps( mc, &a_config, beta, warm_up, max_time, sort_freq, &n_good, &n_bad );
+
+        n_good = n_bad = 0;
+        long    pairs = config::stats.n_pairs;
+        double  start = bench_clock();
+        long    steps = run_steps( mc, &a_config, beta, n_steps, max_time, sort_freq, &n_good, &n_bad );
+        double  elapsed = bench_clock() - start;
+        pairs = config::stats.n_pairs - pairs;
+        if(( steps < n_steps ) && verbose )
+            std::cerr << "Time limit reached after " << steps << " steps\n";
+
+        fprintf( dest, "{\"bench\": \"mc\", \"system\": \"%s\", \"n\": %d, \"atoms\": %d, "
+                "\"fraction\": %g, \"beta\": %g, \"steps\": %ld, \"seconds\": %.6g, "
+                "\"steps_per_s\": %.6g, \"acceptance\": %.6g, \"pairs_per_step\": %.6g, "
+                "\"ns_per_pair\": %.6g, \"energy\": %.10g}\n",
+                system, n, n_atoms, fraction, beta, steps, elapsed,
+                steps / elapsed, (double)n_good / ( n_good + n_bad ),
+                (double)pairs / steps, pairs ? 1e9 * elapsed / pairs : 0.0,
+                a_config->energy( forces ));
+        fflush( dest );
+
+        delete a_topology;
+        delete forces;
+        delete a_config;
+    }
+    if( dest != stdout ) fclose( dest );
+    return EXIT_SUCCESS;
+}
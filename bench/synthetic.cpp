@@ -0,0 +1,167 @@
+/**
+ * @file    synthetic.cpp
+ * @brief   Implementation of the synthetic systems used by the benchmarks.
+ *
+ * The topology and force fields are copies of the files in test_alex/ and
+ * test/ so that the benchmarks do not depend on the working directory.
+ */
+
+#include "synthetic.h"
+#include "../Classes/common.h"
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+static const char *topology_text =      // test_alex/requiered_files_simulation/topo3eps.dat
+    "6\n"
+    "GpA 1\nErbB2 2\nLH2 0.5\nCC 0.5\nMonoAqp 0.5\nPore 0.5\n"
+    "3\n"
+    "Disk\n1\n0 0.0 0.0 Red\n"
+    "Square\n4\n"
+    "2 -0.5 -0.5 Green\n2 -0.5 0.5 Blue\n3 0.5 0.5 Orange\n3 0.5 -0.5 Red\n"
+    "squareplus\n9\n"
+    "4 0.5 0.5 Orange\n4 0.5 -0.5 Red\n4 -0.5 -0.5 Orange\n4 -0.5 0.5 Blue\n"
+    "4 0.5 0.0 Red\n4 0.0 -0.5 Red\n4 0.0 0.5 Blue\n4 -0.5 0.0 Blue\n"
+    "5 0.0 0.0 Green\n";
+
+static const char *square_forces =      // test_alex/requiered_files_simulation/4_atoms.ff
+    "4\n"
+    "1.0 2.0 0.5 0.5\n"
+    "Red Orange Ivory RebeccaPurple\n"
+    "3.0 10.0\n"
+    " 0.0 -4.0 -4.0 -4.0\n"
+    "-4.0  0.0 -1.0  1.0\n"
+    "-4.0 -1.0  0.0 -2.0\n"
+    "-4.0  1.0 -2.0  0.0\n";
+
+static const char *nine_colors =
+    "0.5 0.5 0.5 0.5 0.5 0.5 0.5 0.5 0.5\n"
+    "orange red orange blue red red blue blue green\n"
+    "12 3.0\n";
+
+/**
+ * The nine atom force fields only differ by their well depth, -1.0 for
+ * 9_atoms.ff and -5.5 for AqpZCBOL_zero.ff, the last type (the centre)
+ * interacting with nothing.
+ */
+static std::string
+nine_forces( const char *depth ){
+    std::string text = std::string("9\n") + nine_colors;
+    for( int i = 0; i < 9; i++ ){
+        for( int j = 0; j < 9; j++ )
+            text += std::string(( i < 8 ) && ( j < 8 ) ? depth : "0.0" ) + " ";
+        text += "\n";
+    }
+    return text;
+}
+
+const char *
+system_for_atoms( int atoms ){
+    switch( atoms ){
+        case 1: return "disc";
+        case 4: return "square";
+        case 9: return "squareplus";
+    }
+    return (const char *)NULL;
+}
+
+int
+system_molecule( const char *system ){
+    if( strcmp( system, "disc" ) == 0 ) return 0;
+    if( strcmp( system, "square" ) == 0 ) return 1;
+    if(( strcmp( system, "squareplus" ) == 0 ) || ( strcmp( system, "aqpz" ) == 0 )) return 2;
+    return -1;
+}
+
+topology *
+make_topology(){
+    std::istringstream source( topology_text );
+    return new topology( source );
+}
+
+force_field *
+make_forces( const char *system ){
+    std::string text;
+
+    switch( system_molecule( system )){
+        case 0: return new force_field( 1.0 );  // Hard discs, atom type 0 of radius 1.
+        case 1: text = square_forces; break;
+        case 2: text = nine_forces( strcmp( system, "aqpz" ) == 0 ? "-5.5" : "-1.0" ); break;
+        default:
+            throw std::runtime_error( std::string("Unknown system ") + system + "\n" );
+    }
+    FILE *source = fmemopen( (void *)text.c_str(), text.size(), "r" );
+    if( source == NULL )
+        throw std::runtime_error( "Unable to read the force field from memory\n" );
+    force_field *forces = new force_field( source );
+    fclose( source );
+    return forces;
+}
+
+/**
+ * Place n objects of a system on a jittered square lattice in a periodic
+ * square box. The random number generator should be seeded first.
+ * @param fraction the packing fraction of the bounding circles.
+ */
+config *
+make_config( const char *system, int n, double fraction ){
+    int         molecule = system_molecule( system );
+    topology    *a_topology = make_topology();
+
+    if( molecule < 0 ){
+        delete a_topology;
+        throw std::runtime_error( std::string("Unknown system ") + system + "\n" );
+    }
+    if(( fraction <= 0.0 ) || ( fraction > MAX_FRACTION )){
+        delete a_topology;
+        throw std::runtime_error( "The packing fraction must be above 0 and at most "
+                + std::to_string( MAX_FRACTION ) + "\n" );
+    }
+    double  radius  = a_topology->bounding_radius( molecule );
+    int     m       = (int)ceil( sqrt( (double)n ));
+    double  side    = sqrt( n * M_PI * radius * radius / fraction );
+    double  spacing = side / m;
+    double  jitter  = simple_max( 0.0, 0.5 * spacing - radius );
+
+    config  *a_config = new config();
+    a_config->x_size = side;
+    a_config->y_size = side;
+    a_config->is_periodic = true;
+    a_config->add_topology( a_topology );
+    for( int k = 0; k < n; k++ ){
+        double  x = ( k % m + 0.5 ) * spacing + jitter * ( 2.0 * rnd_uniform() - 1.0 );
+        double  y = ( k / m + 0.5 ) * spacing + jitter * ( 2.0 * rnd_uniform() - 1.0 );
+        object  an_object( molecule, x, y, rnd_lin( M_2PI ));
+        a_config->add_object( &an_object );
+    }
+    return a_config;
+}
+
+double
+bench_clock(){
+    return std::chrono::duration<double>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+std::vector<double>
+parse_list( const char *text ){
+    std::vector<double> values;
+    std::istringstream  source( text );
+    std::string         field;
+
+    while( std::getline( source, field, ',' )){
+        size_t  used = 0;
+        double  value = 0.0;
+        try {
+            value = std::stod( field, &used );
+        }
+        catch( const std::exception& ){
+            used = 0;
+        }
+        if(( used == 0 ) || ( used != field.size() ))
+            throw std::runtime_error( "Bad number '" + field + "' in list " + text + "\n" );
+        values.push_back( value );
+    }
+    return values;
+}
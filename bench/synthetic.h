@@ -0,0 +1,37 @@
+/**
+ * @file    synthetic.h
+ * @brief   Header file for the synthetic systems used by the benchmarks.
+ *
+ * The benchmark programs build their configurations in memory, so that a
+ * measurement depends only on its parameters and the random seed and not
+ * on files lying around. A system is one of the molecules of
+ * test_alex/requiered_files_simulation/topo3eps.dat with a force field:
+ * * disc, the single atom Disk with the default hard disc force field,
+ * * square, the 4 atom Square with the 4_atoms.ff force field,
+ * * squareplus, the 9 atom squareplus with the 9_atoms.ff force field,
+ * * aqpz, the 9 atom squareplus with the test/AqpZCBOL_zero.ff force field.
+ *
+ * Configurations are periodic squares holding n objects on a jittered
+ * square lattice. The packing fraction is the fraction of the area
+ * covered by the bounding circles of the molecules, so the objects never
+ * clash and the fraction can not exceed pi/4.
+ */
+
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "../Classes/config.h"
+#include <vector>
+
+#define MAX_FRACTION    0.785       // Just under pi/4, the densest square lattice.
+
+const char  *system_for_atoms( int atoms );     ///< The system with this many atoms per molecule, NULL if none.
+int         system_molecule( const char *system );      ///< Molecule type used by a system, -1 if unknown.
+topology    *make_topology();                   ///< The topology shared by all the systems.
+force_field *make_forces( const char *system ); ///< The force field of a system.
+config      *make_config( const char *system,   ///< A periodic lattice configuration of a system.
+                int n, double fraction );
+double      bench_clock();                      ///< Wall clock time in seconds.
+std::vector<double> parse_list( const char *text );     ///< Read a comma separated list of numbers.
+
+#endif /* SYNTHETIC_H */
@@ -15,11 +15,220 @@
 // #include <stdio.h>
 // #include <math.h>
 #include <iostream>
+#include <float.h>
+#include <string.h>
+#include <vector>
 #include <unistd.h>
 
 using namespace std;
 
 #define MAX_TESTS	1000
+#define MAX_FREE_CELLS	(1<<22)		// Limit on the size of the free space grid.
+#define LATTICE_GAP	1.0e-4		// Clearance allowing for rounding in the output.
+
+/**
+ * Distance from x, y to the nearest edge of a polygon.
+ */
+double
+edge_distance(polygon *a_poly, double x, double y){
+    double  result = DBL_MAX;
+
+    for( int i = 0; i < a_poly->n_vertex; i++ ){
+        Point   a = a_poly->get_vertex( i );
+        Point   b = a_poly->get_vertex(( i + 1 ) % a_poly->n_vertex );
+        double  ex = b.x - a.x, ey = b.y - a.y;
+        double  len2 = ex * ex + ey * ey;
+        double  t = ( len2 > 0.0 ) ? (( x - a.x ) * ex + ( y - a.y ) * ey ) / len2 : 0.0;
+        t = ( t < 0.0 ) ? 0.0 : (( t > 1.0 ) ? 1.0 : t );
+        double  dx = a.x + t * ex - x, dy = a.y + t * ey - y;
+        result = simple_min( result, sqrt( dx * dx + dy * dy ));
+    }
+    return result;
+}
+
+/**
+ * Record of the parts of the surface where the centre of a new object
+ * could still go. The surface is divided into square cells about half the
+ * core radius of the objects being placed wide. A cell is covered, and no
+ * longer sampled, once every point in it is closer to a placed object than
+ * the sum of the core radii (or too close to a wall) so that any object
+ * centred there would certainly clash. The free cells are kept in a list
+ * so that a random free cell is drawn in constant time.
+ */
+struct free_space {
+    int                 nx, ny;         ///< Number of cells.
+    double              h;              ///< Size of the (square) cells.
+    double              x_min, y_min;   ///< Corner of the area covered.
+    double              x_size, y_size;
+    bool                periodic;
+    double              core;           ///< Core radius of the objects being placed.
+    std::vector<int>    free_list;      ///< Indices of the free cells.
+    std::vector<int>    slot;           ///< Position of each cell in free_list or -1.
+
+    free_space(config *a_config, topology *a_topology, double core_radius);
+    void    cover(int cell);
+    void    cover_around(double x, double y, double reach);
+    bool    sample(double *x, double *y);
+};
+
+/**
+ * Set up the free cells for placing objects of core radius core_radius,
+ * taking into account the walls and the objects already placed.
+ */
+free_space::free_space(config *a_config, topology *a_topology, double core_radius){
+    x_min    = a_config->is_rectangle ? 0.0 : a_config->poly->x_min();
+    y_min    = a_config->is_rectangle ? 0.0 : a_config->poly->y_min();
+    x_size   = a_config->width();
+    y_size   = a_config->height();
+    periodic = a_config->is_periodic;
+    core     = core_radius;
+    h        = core / 2.0;
+    if( x_size * y_size / ( h * h ) > MAX_FREE_CELLS )
+        h = sqrt( x_size * y_size / MAX_FREE_CELLS );
+    nx = simple_max( 1, (int) ceil( x_size / h ));
+    ny = simple_max( 1, (int) ceil( y_size / h ));
+    free_list.resize( nx * ny );
+    slot.resize( nx * ny );
+    for( int i = 0; i < nx * ny; i++ ) free_list[i] = slot[i] = i;
+
+    double  half_diagonal = h * M_SQRT1_2;
+    if( !a_config->is_rectangle ){      // Outside or along the polygon.
+        polygon *a_poly = a_config->poly;
+        for( int k = 0; k < nx; k++ ){
+            for( int l = 0; l < ny; l++ ){
+                double  x = x_min + ( k + 0.5 ) * h;
+                double  y = y_min + ( l + 0.5 ) * h;
+                double  d = edge_distance( a_poly, x, y );
+                if( a_poly->is_inside( x, y ) ? ( d + half_diagonal < core )
+                                              : ( d > half_diagonal ))
+                    cover( k * ny + l );
+            }
+        }
+    } else if( !periodic ){             // Strips along the walls.
+        for( int k = 0; k < nx; k++ ){
+            for( int l = 0; l < ny; l++ ){
+                if(( (k+1)*h < core ) || ( k*h > x_size - core ) ||
+                   ( (l+1)*h < core ) || ( l*h > y_size - core ))
+                    cover( k * ny + l );
+            }
+        }
+    }
+    for( int i = 0; i < a_config->n_objects(); i++ ){
+        object *an_object = a_config->get_object( i );
+        cover_around( an_object->pos_x, an_object->pos_y,
+                      core + a_topology->core_radius( an_object->o_type ));
+    }
+}
+
+void
+free_space::cover(int cell){
+    int position = slot[cell];
+    if( position < 0 ) return;
+    int last = free_list.back();
+    free_list[position] = last;
+    slot[last] = position;
+    free_list.pop_back();
+    slot[cell] = -1;
+}
+
+/**
+ * Cover the cells that lie entirely within reach of x, y.
+ */
+void
+free_space::cover_around(double x, double y, double reach){
+    double  half_diagonal = h * M_SQRT1_2;
+    int     n = (int) ceil( reach / h ) + 1;
+    int     k0 = (int) floor(( x - x_min ) / h );
+    int     l0 = (int) floor(( y - y_min ) / h );
+
+    for( int k = k0 - n; k <= k0 + n; k++ ){
+        int kk = k;
+        if( periodic ) kk = (( k % nx ) + nx ) % nx;
+        else if(( k < 0 ) || ( k >= nx )) continue;
+        double dx = x_min + ( k + 0.5 ) * h - x;
+        for( int l = l0 - n; l <= l0 + n; l++ ){
+            int ll = l;
+            if( periodic ) ll = (( l % ny ) + ny ) % ny;
+            else if(( l < 0 ) || ( l >= ny )) continue;
+            double dy = y_min + ( l + 0.5 ) * h - y;
+            if( sqrt( dx*dx + dy*dy ) + half_diagonal < reach )
+                cover( kk * ny + ll );
+        }
+    }
+}
+
+/**
+ * Draw a random position in a random free cell.
+ * @return false if there are no free cells left.
+ */
+bool
+free_space::sample(double *x, double *y){
+    if( free_list.empty() ) return false;
+    int index = simple_min( (int) rnd_lin( free_list.size() ), (int)free_list.size() - 1 );
+    int cell  = free_list[ index ];
+    double x0 = ( cell / ny ) * h;
+    double y0 = ( cell % ny ) * h;
+    *x = x_min + x0 + rnd_lin( simple_min( h, x_size - x0 ));   // Cells on the edge
+    *y = y_min + y0 + rnd_lin( simple_min( h, y_size - y0 ));   // may be cut short.
+    return true;
+}
+
+/**
+ * Find the sites of a lattice that fill the configuration. With periodic
+ * boundaries the lattice is stretched slightly so that a whole number of
+ * cells fits in each direction (an even number of rows for the hexagonal
+ * lattice). Otherwise the lattice is centred in the container and only the
+ * sites where a disc of radius 'radius' fits inside the walls are kept.
+ *
+ * @param a_config the (empty) configuration giving the container.
+ * @param hexagonal true for a hexagonal lattice, false for a square one.
+ * @param spacing the distance between nearest neighbour sites.
+ * @param radius the bounding radius of the objects to place.
+ * @param sites the lattice sites found.
+ */
+void
+lattice_sites(config *a_config, bool hexagonal, double spacing, double radius,
+              std::vector<Point>& sites){
+    double  x_min = a_config->is_rectangle ? 0.0 : a_config->poly->x_min();
+    double  y_min = a_config->is_rectangle ? 0.0 : a_config->poly->y_min();
+    double  width = a_config->width();
+    double  height = a_config->height();
+    double  row = hexagonal ? spacing * sqrt(3.0) / 2.0 : spacing;
+    double  dx = spacing, dy = row;
+    int     nx, ny;
+
+    sites.clear();
+    if( a_config->is_periodic ){
+        nx = simple_max( 1, (int) floor( width / spacing ));
+        ny = simple_max( 1, (int) floor( height / row ));
+        if( hexagonal && ( ny > 1 ) && ( ny % 2 )) ny--;
+        dx = width / nx;
+        dy = height / ny;
+    } else {
+        nx = (int) floor( width / dx ) + 1;
+        ny = (int) floor( height / dy ) + 1;
+        x_min += ( width - ( nx - 1 ) * dx - ( hexagonal ? dx / 2.0 : 0.0 )) / 2.0;
+        y_min += ( height - ( ny - 1 ) * dy ) / 2.0;
+    }
+    for( int j = 0; j < ny; j++ ){
+        for( int i = 0; i < nx; i++ ){
+            double  x = ( i + (( hexagonal && ( j % 2 )) ? 0.5 : 0.0 )) * dx;
+            double  y = j * dy;
+            if( a_config->is_periodic ){
+                x = fmod( x + dx / 2.0, width );
+                y += dy / 2.0;
+            } else {
+                x += x_min;
+                y += y_min;
+                if( a_config->is_rectangle ){
+                    if(( x < radius ) || ( x > width - radius ) ||
+                       ( y < radius ) || ( y > height - radius )) continue;
+                } else if( !a_config->poly->is_inside( x, y, radius )) continue;
+            }
+            sites.push_back( Point( x, y ));
+        }
+    }
+}
 
 string placement_failure  = ""
 "Fatal Error: Unable to place objects without "
@@ -32,19 +241,24 @@ string placement_failure  = ""
 void usage()
 {
     std::cerr << "Usage: makeconfig [-v][-p][-t topo_file][-o out_file][-f force_file]"
-        "[-d scale][-a attempts] \n\t x_size y_size n_obj0 ... \n";
+        "[-d scale][-a attempts][-l hex|square][-s spacing][-F] \n"
+        "\t x_size y_size n_obj0 ... \n"
+        "   or: makeconfig [options] -b container n_obj0 ... \n";
 }
 
 int 
 main(int argc, char **argv)
 {
-    int     	n, c;
+    int     	c;
     float   	x_size, y_size;
     double  	pos_x, pos_y, orient;
-    char  	*out_name, *topo_name, *force_name;
+    char  	*out_name, *topo_name, *force_name, *container_name;
+    char  	*lattice = NULL;
     bool        verbose = false;
+    bool        fill = false;
     bool        clash = true;
     int		max_try = MAX_TESTS;
+    double	spacing = 0.0;
     object      *my_object;
 
     config      *a_config = new config();
@@ -53,18 +267,19 @@ main(int argc, char **argv)
     a_config->is_periodic = false;
 
     float   scale = 1.0;
-    out_name = force_name = topo_name = NULL;
+    out_name = force_name = topo_name = container_name = NULL;
     the_force = (force_field *)NULL;
     a_topology = (topology *)NULL;
 
     // Getopt based argument handling.
 
-    while( ( c = getopt (argc, argv, "vpd:f:t:o:a:") ) != -1 )
+    while( ( c = getopt (argc, argv, "vpd:f:t:o:a:l:s:Fb:") ) != -1 )
     {
         switch(c)
         {
             case 'v': verbose = true; break;
             case 'p': a_config->is_periodic = true; break;
+            case 'F': fill = true; break;
             case 'd':				// Handle optional arguments
                 if (optarg) scale = std::atof(optarg);
                 break;
@@ -80,12 +295,22 @@ main(int argc, char **argv)
             case 'o':
                 if (optarg) out_name = optarg;
                 break;
+            case 'b':
+                if (optarg) container_name = optarg;
+                break;
+            case 'l':
+                if (optarg) lattice = optarg;
+                break;
+            case 's':
+                if (optarg) spacing = std::atof(optarg);
+                break;
             case 'h':
                 usage();
                 return 0;
             case '?':				// Something wrong.
                 if (optopt == 'd' or optopt == 'f' or optopt =='t' or 
-                    optopt == 'o' or optopt == 'a' ){
+                    optopt == 'o' or optopt == 'a' or optopt == 'b' or
+                    optopt == 'l' or optopt == 's' ){
                     std::cerr << "The -" << optopt << " option is missing a parameter!\n";
                 } else {
                     std::cerr << "Unknown option " << optopt << "!\n";
@@ -98,15 +323,50 @@ main(int argc, char **argv)
     if( verbose ){                              // Report on situation
         std::cerr << "Verbose flag set\n";
     }
-
-    if(( argc - optind ) < 3 ){			// Check enough parameters
-        std::cerr << "Not enough parameters!\n";
+    if( lattice && strcmp( lattice, "hex" ) && strcmp( lattice, "square" )){
+        std::cerr << "Unknown lattice " << lattice << ", use hex or square!\n";
         usage();
         return 1;
     }
+    if( fill && !lattice ){
+        std::cerr << "The -F option needs a lattice (-l)!\n";
+        usage();
+        return 1;
+    }
+
+    if( container_name ){			// Take the container from a configuration.
+        if(( argc - optind ) < 1 ){
+            std::cerr << "Not enough parameters!\n";
+            usage();
+            return 1;
+        }
+        try{
+            config container( container_name );
+            a_config->x_size = x_size = container.x_size;
+            a_config->y_size = y_size = container.y_size;
+            if( !container.is_rectangle ){
+                a_config->set_poly( new polygon( container.poly ));
+                x_size = a_config->width();
+                y_size = a_config->height();
+            }
+        }
+        catch(const std::exception& e){
+            std::cerr << e.what() << "Unable to read the container. Aborting!\n";
+            delete a_config;
+            return EXIT_FAILURE;
+        }
+    } else {
+        if(( argc - optind ) < 3 ){			// Check enough parameters
+            std::cerr << "Not enough parameters!\n";
+            usage();
+            return 1;
+        }
 
-    x_size = std::atof( argv[ optind++ ] );	// Find size for configuration
-    y_size = std::atof( argv[ optind++ ] );
+        x_size = std::atof( argv[ optind++ ] );	// Find size for configuration
+        y_size = std::atof( argv[ optind++ ] );
+        a_config->x_size = x_size;
+        a_config->y_size = y_size;
+    }
 
     if((x_size * y_size) <= 0.0 ){
         std::cerr << "Negative or zero surface area!\n";
@@ -144,6 +404,19 @@ main(int argc, char **argv)
     }
 
     a_config->add_topology(a_topology);         // Assocuate topology with the configuration.
+
+    int n_types = argc - optind;                // Check the molecule types.
+    for( int i = 1; i < n_types; i++ ){
+        if( topo_name == NULL ){                // Need to add another simple molecule to the topology
+            a_topology->add_molecule(1.0);
+        }
+    }
+    if( n_types > (int)a_topology->n_molecules ){
+        std::cerr << "The topology does not contain sufficient molecule types " << n_types << " required! Aborting!\n";
+        delete a_config;
+        if( the_force ) delete the_force;
+        return EXIT_FAILURE;
+    }
     if( verbose ){
         std::cerr << "Set up topology:";
         a_topology->write( std::cerr );
@@ -151,32 +424,89 @@ main(int argc, char **argv)
     }
 
     // Start adding things to the empty configuration
-    x_size /= scale;				// Rescale space if requested.
-    y_size /= scale;
-
-    a_config->x_size = x_size;
-    a_config->y_size = y_size;
-    
-    for( int i = 0; i < (argc - optind); i++) {
-        n = std::atof( argv[ optind+i ] );
-        if(verbose){
-            std::cerr << "Adding " << n << " objects of type " << i << ".\n";
+    a_config->expand( 1.0 / scale );		// Rescale space if requested.
+
+    if( lattice ){                              // Fill lattice sites.
+        bool    hexagonal = ( strcmp( lattice, "hex" ) == 0 );
+        double  radius = 0.0;
+        std::vector<Point>  sites;
+        std::vector<int>    counts( n_types );
+        double  total = 0.0;
+
+        for( int i = 0; i < n_types; i++ ){
+            radius = simple_max( radius, a_topology->bounding_radius( i ));
+            total += std::atof( argv[ optind + i ] );
         }
-        if( topo_name == NULL && i > 0){	// Need to add another simple molecule to the topology
-            a_topology->add_molecule(1.0);
+        if( spacing <= 0.0 ) spacing = 2.0 * radius + LATTICE_GAP;
+        lattice_sites( a_config, hexagonal, spacing, radius + LATTICE_GAP, sites );
+
+        int n_sites = sites.size();             // Number of each type.
+        int n_placed = 0;
+        double  so_far = 0.0;
+        for( int i = 0; i < n_types; i++ ){
+            double n_i = std::atof( argv[ optind + i ] );
+            if( fill ){                         // Proportions of all the sites.
+                so_far += n_i;
+                counts[i] = (int) floor( n_sites * so_far / total + 0.5 ) - n_placed;
+            } else {
+                counts[i] = (int) n_i;
+            }
+            n_placed += counts[i];
         }
-        if( i >= (int)a_topology->n_molecules ){
-            std::cerr << "The topology does not contain sufficient molecule types " << (i+1) << " required! Aborting!\n";
+        if( n_placed > n_sites ){
+            std::cerr << "Only " << n_sites << " lattice sites for " << n_placed
+                      << " objects! Aborting!\n";
             delete a_config;
             if( the_force ) delete the_force;
             return EXIT_FAILURE;
         }
+        for( int k = n_sites - 1; k > 0; k-- ){ // Random choice of sites.
+            int j = simple_min( (int) rnd_lin( k + 1 ), k );
+            std::swap( sites[k], sites[j] );
+        }
+        int k = 0;
+        for( int i = 0; i < n_types; i++ ){
+            if(verbose){
+                std::cerr << "Adding " << counts[i] << " objects of type " << i
+                          << " on " << lattice << " lattice sites.\n";
+            }
+            for( int j = 0; j < counts[i]; j++, k++ ){
+                object an_object( i, sites[k].x, sites[k].y, rnd_lin(M_2PI) );
+                a_config->add_object( &an_object );
+            }
+        }
+        if( verbose ){
+            std::cerr << n_placed << " of " << n_sites << " lattice sites used.\n";
+        }
+        if( a_config->test_clash() ){
+            std::cerr << "Warning: the lattice spacing " << spacing
+                      << " is too small, objects overlap!\n";
+        }
+    }
+
+    int n_random = lattice ? 0 : n_types;       // Otherwise random insertion.
+    for( int i = 0; i < n_random; i++) {
+        int n = std::atof( argv[ optind+i ] );
+        if(verbose){
+            std::cerr << "Adding " << n << " objects of type " << i << ".\n";
+        }
+        a_config->build_grid();                 // Only test clashes with neighbours.
+        double core = a_topology->core_radius( i );
+        free_space *space = ( core > 0.0 ) ? new free_space( a_config, a_topology, core ) : NULL;
 
         for(int j = 0; j < n; j++ ){            // Try to place 'n' new objects of type i
             clash = true;
             for( int k = 0; ((k < max_try) && clash ); k++ ){
-                pos_x  = rnd_lin(a_config->x_size);
-                pos_y  = rnd_lin(a_config->y_size);
+                if( space ){                    // Sample only the free space.
+                    if( !space->sample( &pos_x, &pos_y )) break;
+                } else {
+                    pos_x  = rnd_lin(a_config->width());
+                    pos_y  = rnd_lin(a_config->height());
+                    if( !a_config->is_rectangle ){
+                        pos_x += a_config->poly->x_min();
+                        pos_y += a_config->poly->y_min();
+                    }
+                }
                 orient = rnd_lin(M_2PI);
                 my_object = new object( i, pos_x, pos_y, orient );
                 clash = a_config->test_clash( my_object );
@@ -184,13 +514,21 @@ main(int argc, char **argv)
             }
             if( !clash ){
                 a_config->add_object( my_object );
+                if( space ) space->cover_around( pos_x, pos_y, 2.0 * core );
+                delete my_object;
             } else {
+                if( space ) delete space;
 		std::cerr << placement_failure;
                 delete a_config;
                 if(the_force) delete the_force;
                 exit(EXIT_FAILURE);
             }
         }
+        if( verbose && space ){
+            std::cerr << space->free_list.size() << " of " << space->nx * space->ny
+                      << " cells still free after type " << i << ".\n";
+        }
+        if( space ) delete space;
     }
     if(verbose){
         std::cerr << "Finished placing objects.\n";
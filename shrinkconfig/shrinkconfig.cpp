@@ -12,17 +12,124 @@
  */
 
 #include "../Classes/config.h"
+#include "../Classes/integrator.h"
 // #include <stdio.h>
 // #include <math.h>
+#include <float.h>
 #include <iostream>
+#include <time.h>
 #include <unistd.h>
 
 using namespace std;
 
+#define COMPRESS_TRIES  100         // Default attempts to remove clashes when compressing.
+#define COMPRESS_STEP   0.98        // Default linear scale factor of a compression step.
+#define MIN_STEP        1.0e-4      // Give up when the steps are smaller than this.
+#define AREA_GRID       400         // Grid used to measure the area of a molecule.
+
+/**
+ * Area covered by a molecule, the union of its atoms, measured on a fine
+ * grid over the bounding box of the atoms.
+ */
+double
+molecule_area(topology *a_topology, int mol){
+    double  x_min = DBL_MAX, x_max = -DBL_MAX, y_min = DBL_MAX, y_max = -DBL_MAX;
+    int     n_atoms = a_topology->molecules(mol).n_atoms;
+    long    n_in = 0;
+
+    for( int j = 0; j < n_atoms; j++ ){
+        atom&   an_atom = a_topology->molecules(mol).the_atoms(j);
+        double  r = a_topology->atom_sizes( an_atom.type );
+        x_min = simple_min( x_min, an_atom.x_pos - r );
+        x_max = simple_max( x_max, an_atom.x_pos + r );
+        y_min = simple_min( y_min, an_atom.y_pos - r );
+        y_max = simple_max( y_max, an_atom.y_pos + r );
+    }
+    if( n_atoms == 0 ) return 0.0;
+    double  dx = ( x_max - x_min ) / AREA_GRID;
+    double  dy = ( y_max - y_min ) / AREA_GRID;
+    for( int k = 0; k < AREA_GRID; k++ ){
+        double  x = x_min + ( k + 0.5 ) * dx;
+        for( int l = 0; l < AREA_GRID; l++ ){
+            double  y = y_min + ( l + 0.5 ) * dy;
+            for( int j = 0; j < n_atoms; j++ ){
+                atom&   an_atom = a_topology->molecules(mol).the_atoms(j);
+                double  r = a_topology->atom_sizes( an_atom.type );
+                if(( x - an_atom.x_pos ) * ( x - an_atom.x_pos ) +
+                   ( y - an_atom.y_pos ) * ( y - an_atom.y_pos ) < r * r ){
+                    n_in++;
+                    break;
+                }
+            }
+        }
+    }
+    return n_in * dx * dy;
+}
+
+/**
+ * Compress a configuration to the target area in small steps. Each step
+ * shrinks the configuration (removing any clashes with up to max_try
+ * attempts) and is followed by a short Monte Carlo relaxation of 'sweeps'
+ * moves per object. When the clashes can not be removed the step is undone
+ * and the next steps are made smaller.
+ *
+ * @param state_h handle on the configuration, replaced by the compressed one.
+ * @param the_forces force field for the Monte Carlo relaxation.
+ * @param target target area.
+ * @param covered total area of the objects, for reporting packing fractions.
+ * @param step linear scale factor of a step (less than 1).
+ * @param max_try attempts to remove clashes after a step.
+ * @param sweeps Monte Carlo moves per object after each step.
+ * @param beta reciprocal temperature of the relaxation.
+ * @param verbose report each step.
+ * @return true if the target area was reached.
+ */
+bool
+compress(config **state_h, force_field *the_forces, double target, double covered,
+         double step, int max_try, int sweeps, double beta, bool verbose){
+    config      *a_config = *state_h;
+    integrator  the_integrator( the_forces );
+    clock_t     start = clock();
+    double      area = a_config->area();
+    int         n_round = 0;
+
+    while( area > target ){
+        double  dl = simple_max( step, sqrt( target / area ));
+        config  *backup = new config( a_config );
+
+        if( a_config->expand( dl, max_try )){   // Clashes left, undo and slow down.
+            delete a_config;
+            a_config = backup;
+            step = sqrt( step );
+            if( step > 1.0 - MIN_STEP ) break;
+        } else {
+            delete backup;
+        }
+        if( sweeps > 0 )
+            the_integrator.run( &a_config, beta, 0.0, sweeps * a_config->n_objects() );
+        area = a_config->area();
+        n_round++;
+        if( verbose ){
+            std::cerr << "Step " << n_round << " area " << area
+                      << " packing fraction " << covered / area
+                      << " cpu " << (double)( clock() - start ) / CLOCKS_PER_SEC << " s\n";
+        }
+    }
+    double cpu = (double)( clock() - start ) / CLOCKS_PER_SEC;
+    double rate = ( covered / area ) / (( cpu > 1.0e-3 ) ? cpu : 1.0e-3 );
+    std::cerr << "Reached packing fraction " << covered / area << " (area " << area
+              << ") in " << n_round << " steps and " << cpu << " s cpu, "
+              << rate << " per second.\n";
+    *state_h = a_config;
+    return( area <= target );
+}
+
 void usage()
 {
     std::cerr << "Usage: shrinkconfig [-v][-p][-t topo_file][-o out_file][-f force_file]"
-        "[-s scale_factor][-a attempts] [source] \n";
+        "[-s scale_factor][-a attempts] [source] \n"
+        "   or: shrinkconfig [options] (-A area | -P packing_fraction)[-r step]"
+        "[-m sweeps][-b beta] [source] \n";
 }
 
 int 
@@ -37,11 +144,18 @@ main(int argc, char **argv)
     char        *out_name, *topo_name;
     out_name = topo_name = NULL;
     bool        verbose = false;
-    int         max_try = 1.0;
+    int         max_try = 0;
+    char        *force_name = NULL;
+    double      target_area = 0.0;          // Compression mode settings.
+    double      target_fraction = 0.0;
+    double      step = COMPRESS_STEP;
+    int         sweeps = 2;
+    double      beta = 1.0;
+    force_field *the_forces = (force_field *)NULL;
 
     // Getopt based argument handling.
 
-    while( ( c = getopt (argc, argv, "hvs:t:o:a:") ) != -1 )
+    while( ( c = getopt (argc, argv, "hvs:t:o:a:f:A:P:r:m:b:") ) != -1 )
     {
         switch(c)
         {
@@ -55,6 +169,24 @@ main(int argc, char **argv)
             case 't':
                 if (optarg) topo_name = optarg;
                 break;
+            case 'f':
+                if (optarg) force_name = optarg;
+                break;
+            case 'A':
+                if (optarg) target_area = std::atof(optarg);
+                break;
+            case 'P':
+                if (optarg) target_fraction = std::atof(optarg);
+                break;
+            case 'r':
+                if (optarg) step = std::atof(optarg);
+                break;
+            case 'm':
+                if (optarg) sweeps = std::atoi(optarg);
+                break;
+            case 'b':
+                if (optarg) beta = std::atof(optarg);
+                break;
             case 'o':
                 if (optarg) out_name = optarg;
                 break;
@@ -63,7 +195,9 @@ main(int argc, char **argv)
                 return 0;
             case '?':				// Something wrong.
                 if (optopt == 's' or optopt =='t' or 
-                    optopt == 'o' or optopt == 'a' ){
+                    optopt == 'o' or optopt == 'a' or optopt == 'f' or
+                    optopt == 'A' or optopt == 'P' or optopt == 'r' or
+                    optopt == 'm' or optopt == 'b' ){
                     std::cerr << "The -" << optopt << " option is missing a parameter!\n";
                 } else {
                     std::cerr << "Unknown option " << optopt << "!\n";
@@ -73,6 +207,13 @@ main(int argc, char **argv)
                 exit(EXIT_FAILURE);
         }
     }
+    bool compressing = ( target_area > 0.0 ) || ( target_fraction > 0.0 );
+    if( max_try <= 0 ) max_try = compressing ? COMPRESS_TRIES : 1;
+    if( compressing && (( step <= 0.0 ) || ( step >= 1.0 ))){
+        std::cerr << "The compression step must be between 0 and 1!\n";
+        usage();
+        exit(EXIT_FAILURE);
+    }
 
     if( verbose ){                              // Report on situation
         std::cerr << "Verbose flag set\n";
@@ -144,10 +285,40 @@ main(int argc, char **argv)
         std::cerr << "================\n";
     }
 
+    double covered = 0.0;                       // Area of the objects.
+    if( compressing ){
+        std::vector<double> areas( a_topology->n_molecules );
+        for( size_t i = 0; i < a_topology->n_molecules; i++ )
+            areas[i] = molecule_area( a_topology, i );
+        for( int i = 0; i < a_config->n_objects(); i++ )
+            covered += areas[ a_config->get_object(i)->o_type ];
+    }
+
     a_config->add_topology(a_topology);         // Associate topology with the configuration.
     a_topology = (topology *)NULL;		// Unnecessary but to be tidy and avoid double deletes.
 
-    if(a_config->expand( scale , max_try )){    // Rescale configuration after placement.
+    if( compressing ){                          // Gradual compression to the target.
+        if( target_fraction > 0.0 ) target_area = covered / target_fraction;
+        try{
+            if( force_name )
+                the_forces = new force_field( force_name );
+            else
+                the_forces = new force_field( 1.0 );    // Default hard disc force field.
+        }
+        catch(const std::exception& e){
+            std::cerr << e.what() << "Failed to read force field\n";
+            delete a_config;
+            exit(EXIT_FAILURE);
+        }
+        bool reached = compress( &a_config, the_forces, target_area, covered,
+                                 step, max_try, sweeps, beta, verbose );
+        delete the_forces;
+        if( !reached ){
+            std::cerr << "Unable to reach the target area, try a smaller step or more sweeps\n";
+            delete a_config;
+            return EXIT_FAILURE;
+        }
+    } else if(a_config->expand( scale , max_try )){    // Rescale configuration after placement.
         if( verbose ){
             std::cerr << "Unable to remove clashes... try increasing attempts or scale\n";
         }
@@ -1,7 +1,11 @@
 
 #include "../Classes/config.h"
+#include "../Classes/space_curve.h"
 #include <cassert>
 #include <exception>
+#include <cmath>
+#include <cstring>
+#include <sstream>
 
 #define EPSILON 1e-15
 
@@ -34,6 +38,174 @@ int main()
     assert( ! config4->expand(2.0));			// No associated topology
     assert(( config4->area()-4*value) < EPSILON );
 
+    printf("Testing the convex hull for Class config\n");
+
+    config* config7 = new config("test2.config");
+    config7->add_topology( new topology("test2.topo") );
+    polygon* hull = config7->convex_hull(false);	// Around the centres
+    assert( hull->n_vertex >= 3 );
+    assert( hull->n_vertex <= config7->n_objects() );
+    assert( hull->winding() > 0 );			// Clockwise
+    delete hull;
+
+    config* config8 = new config();			// Empty container from the hull
+    config8->add_topology( new topology("test2.topo") );
+    config8->set_poly( config7->convex_hull(true) );	// Around all the atoms
+    for( int i = 0; i < config7->n_objects(); i++ ){
+        assert( ! config8->test_clash( config7->get_object(i) ));
+    }
+    delete config7;
+    delete config8;
+
+    printf("Testing the single atom kernels for Class config\n");
+
+    topology* discs = new topology("test2.topo");
+    discs->n_molecules = 1;				// Only the single atom Disk
+    config* config9 = new config();
+    config* config10 = new config();
+    config9->x_size = config9->y_size = config10->x_size = config10->y_size = 12.0;
+    config9->add_topology( discs );
+    config10->add_topology( new topology("test2.topo") );
+    for( int i = 0; i < 30; i++ ){
+        object disc( 0, 1.0 + (i*37 % 100) / 10.0, 1.0 + (i*61 % 100) / 10.0, i );
+        config9->add_object( &disc );
+        config10->add_object( &disc );
+    }
+    force_field* forces = new force_field("test1.ff");
+    double e9  = config9->energy( forces );
+    double e10 = config10->energy( forces );
+    assert( fabs( e9 - e10 ) <= 1e-12 * fabs( e10 ));
+    assert( config9->test_clash() == config10->test_clash() );
+    for( int i = 0; i < 100; i++ ){
+        object probe( 0, 1.5 + i % 10, 1.5 + i / 10, 0.0 );
+        assert( config9->test_clash( &probe ) == config10->test_clash( &probe ));
+    }
+
+    printf("Testing cached energies after a move for Class config\n");
+
+    config* moved = new config( *config10 );		// Keeps the cached energies
+    moved->invalidate_within( forces->cut_off, 3 );
+    moved->get_object(3)->move( 2.5, -1.5 );
+    moved->invalidate_within( forces->cut_off, 3 );
+    moved->unchanged = false;
+    std::stringstream copy;
+    moved->write( copy );
+    config* fresh = new config( copy );		// Everything recalculated
+    fresh->add_topology( new topology("test2.topo") );
+    double e_moved = moved->energy( forces );
+    assert( fabs( e_moved - fresh->energy( forces )) <= 1e-12 * fabs( e_moved ));
+
+    printf("Testing the energy check for Class config\n");
+
+    std::stringstream report;
+    assert( moved->check_energy( forces, 1e-9, report ) == 0 );
+    assert( config9->check_energy( forces, 1e-9, report ) == 0 );
+    moved->get_object(5)->set_energy( moved->get_object(5)->get_energy() + 1.0 );
+    assert( moved->check_energy( forces, 1e-9, report ) == 1 );
+    assert( report.str().find( "object 5 " ) != std::string::npos );
+
+    printf("Testing the step size resets for Class config\n");
+
+    config10->set_obj_dl_max( 0, 5 );
+    config10->reset_obj_dl_max( 3.0 );			// Pending for every object
+    config10->set_obj_dl_max( 1, 7 );			// Set after the reset
+    config* reset = new config( *config10 );
+    reset->modif_mobility( 0, true, 10 );		// 3.0 * 1.1
+    reset->modif_mobility( 2, false, 10, false );	// Counted, not changed
+    std::stringstream tallies;
+    reset->write_tallies( tallies );
+    std::string columns = tallies.str();
+    int n_tally = reset->n_objects();
+    float steps[3];
+    memcpy( steps, columns.data() + sizeof(int) * ( 1 + 4 * n_tally ), sizeof(steps) );
+    assert( fabs( steps[0] - 3.3f ) < 1e-5 );
+    assert( steps[1] == 7.0f );
+    assert( steps[2] == 3.0f );
+
+    printf("Testing the reordering of objects for Class config\n");
+
+    config* shuffled = new config( *config10 );	// 30 discs with a topology
+    double e_before = shuffled->energy( forces );
+    std::stringstream before, after;
+    shuffled->write( before );
+    std::vector<int> new_index;
+    shuffled->sort_objects( new_index );
+    assert( (int)new_index.size() == shuffled->n_objects() );
+    int n_moved = 0;
+    for( int i = 0; i < shuffled->n_objects(); i++ ){
+        object *an_object = shuffled->get_object( new_index[i] );
+        if( new_index[i] != i ) n_moved++;
+        assert( an_object->obj_id == i );		// Objects keep their identity
+        assert( !an_object->recalculate );		// and their cached energies
+    }
+    assert( n_moved > 0 );
+    shuffled->write( after );
+    assert( before.str() == after.str() );		// Written in the original order
+    assert( shuffled->energy( forces ) == e_before );
+    assert( shuffled->check_energy( forces, 1e-9, report ) == 0 );
+    delete shuffled;
+    delete reset;
+    delete moved;
+    delete fresh;
+    delete forces;
+    delete config9;
+    delete config10;
+
+    printf("Testing the molecule symmetries for Class config\n");
+
+    topology* symmetric = new topology("test2.topo");
+    assert( symmetric->symmetry(0) == 0 );		// A disc
+    assert( symmetric->symmetry(1) == 4 );		// squareplus
+    std::istringstream declared( "2\nA 1\nB 1\n3\nTrimer\n3\n0 1 0 Red\n0 -0.5 0.866 Red\n0 -0.5 -0.866 Red\n"
+                                 "Pair\nsymmetry 1\n2\n0 1 0 Red\n0 -1 0 Red\nMixed\n2\n0 1 0 Red\n1 -1 0 Red\n" );
+    topology* trimers = new topology( declared );
+    assert( trimers->symmetry(0) == 3 );		// Found with rounded positions
+    assert( trimers->symmetry(1) == 1 );		// As declared
+    assert( trimers->symmetry(2) == 1 );		// Different atom types
+    trimers->add_molecule( 0.5 );			// Named "Hard disk"
+    std::stringstream written;
+    trimers->write( written );
+    topology* reread = new topology( written );
+    assert( reread->n_molecules == trimers->n_molecules );
+    for( size_t m = 0; m < reread->n_molecules; m++ ){
+        assert( reread->molecules(m).mol_name == trimers->molecules(m).mol_name );
+        assert( reread->symmetry(m) == trimers->symmetry(m) );
+        assert( reread->molecules(m).n_atoms == trimers->molecules(m).n_atoms );
+    }
+    assert( reread->molecules(3).mol_name == "Hard disk" );
+    delete reread;
+    config* rotating = new config( *config1 );
+    rotating->add_topology( symmetric );
+    assert( rotating->side_object(0) == 0 );
+    assert( rotating->side_object(1) == 4 );
+    for( int i = 0; i < 100; i++ ){
+        float angle = rotating->rnd_rotate( 4, 0.5 );
+        assert(( fabs( angle ) >= 0.0174 ) && ( fabs( angle ) <= M_PI / 4 + 1e-6 ));
+    }
+    delete rotating;
+    delete trimers;
+
+    printf("Testing the space curve keys for Class config\n");
+
+    std::vector<int> curve_x( 64, -1 ), curve_y( 64, -1 );
+    for( int x = 0; x < 8; x++ )
+        for( int y = 0; y < 8; y++ ){
+            unsigned long key = hilbert_key( 3, x, y );
+            assert( key < 64 && curve_x[key] < 0 );	// Each cell once
+            curve_x[key] = x;
+            curve_y[key] = y;
+            assert( morton_key( 3, x, y ) < 64 );
+        }
+    for( int k = 1; k < 64; k++ )			// Steps between adjacent cells
+        assert( abs( curve_x[k] - curve_x[k-1] ) + abs( curve_y[k] - curve_y[k-1] ) == 1 );
+    std::vector<unsigned long> keys;
+    config1->curve_keys( 10.0, keys );
+    assert( (int)keys.size() == config1->n_objects() );
+    for( int i = 0; i < config1->n_objects(); i++ ){
+        object *an_object = config1->get_object(i);
+        assert( keys[i] == hilbert_key( 4, (int)( an_object->pos_x / 10.0 ), (int)( an_object->pos_y / 10.0 )));
+    }
+
     printf("Testing errors on badly formed files for Class config\n");
 
     try {
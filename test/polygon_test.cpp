@@ -1,6 +1,8 @@
 
 #include "../Classes/polygon.h"
 #include <cassert>
+#include <cmath>
+#include <cstdlib>
 
 int main()
 {
@@ -50,6 +52,96 @@ int main()
     assert( ! poly2->is_inside( poly1 ));
     printf( "Polygon inside tests OK\n");
 
+    assert( fabs( poly1->circle_area( 0.5, 0.5, 0.5 ) - M_PI/4.0 ) < 1e-12 );
+    assert( fabs( poly1->circle_area( 0.5, 0.5, 1.0 ) - 1.0 ) < 1e-12 );
+    assert( fabs( poly1->circle_area( 0.0, 0.0, 0.5 ) - M_PI/16.0 ) < 1e-12 );
+    assert( fabs( poly1->circle_area( 1.0, 0.5, 0.5 ) - M_PI/8.0 ) < 1e-12 );
+    assert( poly1->circle_area( 5.0, 5.0, 1.0 ) == 0.0 );
+    printf( "Circle intersection areas OK\n" );
+
+    Point window[4] = { Point(0.5, 0.5), Point(1.5, 0.5), Point(1.5, 1.5), Point(0.5, 1.5) };
+    assert( fabs( poly1->clip_area( window, 4 ) - 0.25 ) < 1e-12 );
+    assert( fabs( poly3->clip_area( window, 4 ) - 1.00 ) < 1e-12 );
+    polygon* ell = new polygon();		// L shaped, not convex
+    ell->add_vertex( 0.0, 0.0 );
+    ell->add_vertex( 2.0, 0.0 );
+    ell->add_vertex( 2.0, 1.0 );
+    ell->add_vertex( 1.0, 1.0 );
+    ell->add_vertex( 1.0, 2.0 );
+    ell->add_vertex( 0.0, 2.0 );
+    assert( fabs( ell->clip_area( window, 4 ) - 0.75 ) < 1e-12 );
+    assert( fabs( ell->circle_area( 1.0, 1.0, 0.5 ) - 0.75*M_PI*0.25 ) < 1e-12 );
+    assert( ! ell->is_same( poly1 ));
+    assert( poly3->is_same( poly3 ));
+    printf( "Clipped areas OK\n" );
+    delete ell;
+
+    polygon* star = new polygon();		// Concave, checks the query grid
+    const int n_star = 22;
+    Point corner[n_star];
+    for( int i = 0; i < n_star; i++ ){
+        double r = ( i % 2 ) ? 1.0 + 0.3 * ( i % 3 ) : 3.0 + 0.5 * ( i % 5 );
+        double a = -2.0 * M_PI * i / n_star;
+        corner[i] = Point( 5.0 + r * cos( a ), 2.0 + r * sin( a ));
+        star->add_vertex( corner[i].x, corner[i].y );
+    }
+    srand( 17 );
+    for( int trial = 0; trial < 2; trial++ ){
+        for( int n = 0; n < 20000; n++ ){
+            double x = 5.0 + 9.0 * ( rand() / (double)RAND_MAX - 0.5 );
+            double y = 2.0 + 9.0 * ( rand() / (double)RAND_MAX - 0.5 );
+            double r = 0.5 * rand() / (double)RAND_MAX;
+            bool   inside = false;			// Plain crossing count
+            double d_edge = 1e9;
+            for( int i = 0, j = n_star - 1; i < n_star; j = i++ ){
+                Point a = corner[i], b = corner[j];
+                if(( a.y > y ) != ( b.y > y ) &&
+                   ( x < a.x + ( y - a.y ) * ( b.x - a.x ) / ( b.y - a.y )))
+                    inside = !inside;
+                double t = (( x - a.x ) * ( b.x - a.x ) + ( y - a.y ) * ( b.y - a.y ))
+                    / (( b.x - a.x ) * ( b.x - a.x ) + ( b.y - a.y ) * ( b.y - a.y ));
+                t = ( t < 0.0 ) ? 0.0 : (( t > 1.0 ) ? 1.0 : t );
+                d_edge = fmin( d_edge, hypot( x - a.x - t * ( b.x - a.x ), y - a.y - t * ( b.y - a.y )));
+            }
+            if( d_edge < 1e-6 ) continue;		// Too close to call
+            assert( star->is_inside( x, y ) == inside );
+            double signed_d = inside ? d_edge : -d_edge;
+            assert( fabs( star->signed_distance( x, y ) - signed_d ) < 1e-9 );
+            double wall = star->wall_distance( x, y, r );
+            if( signed_d < r ) assert( fabs( wall - signed_d ) < 1e-9 );
+            else assert(( wall >= r ) && ( wall <= signed_d + 1e-9 ));
+            if( fabs( d_edge - r ) > 1e-6 )
+                assert( star->is_inside( x, y, r ) == ( inside && ( d_edge >= r )));
+        }
+        star->translate( 0.0, 0.0 );		// Forces the grid to be rebuilt
+    }
+    star->translate( 100.0, 0.0 );
+    assert( ! star->is_inside( 5.0, 2.0 ));
+    assert( star->is_inside( 105.0, 2.0, 0.9 ));
+    printf( "Query grid and distances agree with the crossing test\n" );
+
+    star->wall_distance( 105.0, 2.0, 0.1 );	// Grid and distances built
+    long n_built = polygon::n_grid_builds;
+    polygon* copy = new polygon( star );
+    assert( copy->is_inside( 105.0, 2.0, 0.9 ));
+    assert( copy->wall_distance( 105.0, 2.0, 0.1 ) == star->wall_distance( 105.0, 2.0, 0.1 ));
+    assert( polygon::n_grid_builds == n_built );	// Shared, not rebuilt
+    copy->translate( -100.0, 0.0 );		// Only the copy changes
+    assert( copy->is_inside( 5.0, 2.0, 0.9 ));
+    assert( star->is_inside( 105.0, 2.0, 0.9 ) && ! star->is_inside( 5.0, 2.0 ));
+    assert( polygon::n_grid_builds == n_built + 1 );
+    copy->translate( 0.0, 0.0 );		// Drops the grid
+    polygon* fresh = new polygon( copy );	// Nothing to share yet
+    polygon* later = new polygon( fresh );
+    assert( later->is_inside( 5.0, 2.0 ));
+    assert( copy->is_inside( 5.0, 2.0 ));	// The original was left alone
+    assert( polygon::n_grid_builds == n_built + 3 );
+    delete later;
+    delete fresh;
+    delete copy;
+    printf( "Copies share the query grid\n" );
+    delete star;
+
     poly2->write(stdout);
 
     delete poly1;